@@ -1,14 +1,18 @@
 import argparse
+import importlib.util
+import itertools
 import json
+import multiprocessing
 import os
 import re
 import shutil
 import subprocess
 import sys
+from concurrent.futures import ProcessPoolExecutor
 from dataclasses import dataclass
 from datetime import datetime
 from pathlib import Path
-from typing import List, Tuple
+from typing import List, Optional, Tuple
 
 # Core helpers
 
@@ -82,6 +86,137 @@ DEFAULT_CASES: List[Case] = [
     Case("lowbit", "clicks", 25.0, 123),
 ]
 
+PRESETS = ["none", "voip", "pstn", "lowbit"]
+NOISES = ["awgn", "pink", "hum", "clicks", "mix"]
+
+def grid_cases(snrs: str, seed: int) -> List[Case]:
+    return [Case(p, n, float(s), seed) for p, n, s in itertools.product(PRESETS, NOISES, snrs.split(","))]
+
+def case_slug(idx: int, c: Case) -> str:
+    return slug(f"{idx:02d}_{c.preset}_{c.noise}_snr{c.snr:g}_seed{c.seed}")
+
+# In-memory pipeline: sender output, channel and receiver input stay float
+# buffers. The library encodes and decodes in-process (phonocrypt.py), and
+# Tester.py's channel functions are called directly. Cases run on a pool of
+# worker processes. With fork the workers share the base signal with the
+# parent (copy-on-write); otherwise each worker gets one copy at start.
+
+_w = {}
+
+def load_module(name: str, path: Path):
+    spec = importlib.util.spec_from_file_location(name, str(path))
+    mod = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(mod)
+    return mod
+
+def pcm16(np, y):
+    # the WAV hop between the tools: clip, 16-bit PCM, back to float
+    return (np.rint(np.clip(y, -1.0, 1.0) * 32767.0) / 32768.0).astype(np.float32)
+
+def worker_init(tester_path: str, lib_path: Optional[str], native: bool, base=None) -> None:
+    import phonocrypt
+    phonocrypt.load(lib_path)
+    _w["tester"] = load_module("Tester", Path(tester_path))
+    _w["pc"] = phonocrypt
+    _w["native"] = native
+    if base is not None:
+        _w["base"] = base
+
+def worker_case(case_name: str, c: Optional[Case]) -> dict:
+    t = _w["tester"]
+    np = t.np
+    x = _w["base"]
+    if c is None:
+        y = x
+    elif _w["native"]:
+        y = _w["pc"].channel(x, _w["fs"], c.preset, c.noise, c.snr, c.seed,
+                             alloc=lambda n: np.empty(n, dtype=np.float32))
+        y = pcm16(np, y)
+    else:
+        y = t.apply_compression_preset(x, _w["fs"], c.preset)
+        y = t.apply_noise(y, _w["fs"], c.noise, c.snr, np.random.default_rng(c.seed))
+        y = pcm16(np, y)
+    r = _w["pc"].decode(y, _w["fs"])
+    if "message" in r:
+        r["message"] = r["message"].decode("utf-8", errors="ignore")
+    r.pop("partial", None)
+    r["case"] = case_name
+    return r
+
+def run_in_memory(cases: List[Case], plaintext: str, root: Path, sender_path: Path, cover_path: Optional[Path],
+                  tester_path: Path, lib_path: Optional[str], native: bool, jobs: int, timeout: int) -> List[Tuple[str, Optional[dict], str]]:
+    sys.path.insert(0, str(root))
+    import numpy as np
+    import phonocrypt
+    phonocrypt.load(lib_path)
+
+    if cover_path:
+        # the cover mixer lives in the sender tool: one run, then memory only
+        import soundfile as sf
+        rc, so, se = run_cmd([str(sender_path), plaintext, str(cover_path)], cwd=root, timeout=timeout)
+        base_wav = root / "encoded_signal.wav"
+        if rc != 0 or not base_wav.exists():
+            print(f"[ERR] sender failed: {se.strip()}")
+            sys.exit(3)
+        audio, fs = sf.read(str(base_wav), dtype="float32")
+        base_wav.unlink(missing_ok=True)
+        base = np.ascontiguousarray(audio if audio.ndim == 1 else audio.mean(axis=1), dtype=np.float32)
+    else:
+        fs = phonocrypt.SAMPLE_RATE
+        base = pcm16(np, np.frombuffer(phonocrypt.encode(plaintext.encode("utf-8")), dtype=np.float32))
+
+    _w["base"] = base
+    _w["fs"] = fs
+    forked = "fork" in multiprocessing.get_all_start_methods()
+    ctx = multiprocessing.get_context("fork" if forked else None)
+    jobs_in = [("base", None)] + [(case_slug(i, c), c) for i, c in enumerate(cases, start=1)]
+    out = []
+    with ProcessPoolExecutor(max_workers=jobs, mp_context=ctx, initializer=worker_init,
+                             initargs=(str(tester_path), lib_path, native, None if forked else base)) as pool:
+        futs = [(name, pool.submit(worker_case, name, c)) for name, c in jobs_in]
+        for name, f in futs:
+            try:
+                out.append((name, f.result(timeout=timeout), ""))
+            except Exception as e:
+                out.append((name, None, f"{type(e).__name__}: {e}"))
+            print(f"[*] Decoded: {name}")
+    return out
+
+def run_sync_check(lib_path: Optional[str]) -> int:
+    """Frames behind decoy preamble bursts (a frame cut before MAGIC): sync
+    has to get past several envelope regions, the real frame's the last.
+    Decoded whole and streamed; 0 if every capture gives the message with
+    its sync on the real frame."""
+    from array import array
+    import phonocrypt
+    phonocrypt.load(lib_path)
+    fs = phonocrypt.SAMPLE_RATE
+    msg = b"sync check: the frame behind the decoys"
+    frame = array("f", bytes(phonocrypt.encode(msg)))
+    pre = phonocrypt.decode(frame)["pos"]       # preamble end, in samples
+    if pre <= 0:
+        print("[ERR] sync check: the clean frame does not decode")
+        return 1
+    gap = array("f", bytes(4 * (fs // 2)))
+    bad = 0
+    # (decoys, fraction of the preamble each one keeps): 3 as strong as the
+    # real one fill the candidate list up to it, 5 weaker ones overflow it
+    for decoys, keep in ((3, 0.97), (5, 0.7)):
+        x = array("f", gap)
+        for _ in range(decoys):
+            x.extend(frame[:int(pre * keep)])
+            x.extend(gap)
+        start = len(x)
+        x.extend(frame)
+        x.extend(gap)
+        for stream in (False, True):
+            r = phonocrypt.decode(x, stream=stream)
+            ok = r.get("message") == msg and r["sync_off"] >= start - fs // 10
+            bad += not ok
+            print(f"[{'OK' if ok else 'FAIL'}] {decoys} decoys, {'stream' if stream else 'whole'}: "
+                  f"sync_off={r['sync_off']} (frame at {start}) {r.get('error', '')}")
+    return 1 if bad else 0
+
 
 def main():
     ap = argparse.ArgumentParser(description="Encrypt->channel stress(noise+compression)->decrypt, save WAVs, compare with message.txt.")
@@ -93,10 +228,26 @@ def main():
     ap.add_argument("--outdir", default="runs", help="Output folder root (default: runs)")
     ap.add_argument("--timeout", type=int, default=300, help="Timeout seconds per command (default: 300)")
     ap.add_argument("--cases", default=None, help="Optional JSON file to override cases")
+    ap.add_argument("--grid", default=None, metavar="SNRS",
+                    help="Run every preset x noise type at these SNRs instead (e.g. 10,15,20)")
+    ap.add_argument("--seed", type=int, default=123, help="Seed of the --grid cases (default: 123)")
+    ap.add_argument("--in-memory", action="store_true",
+                    help="No WAVs or processes per case: encode, stress and decode in-process on float buffers")
+    ap.add_argument("--jobs", type=int, default=os.cpu_count() or 1, help="--in-memory: cases run at once (default: all cores)")
+    ap.add_argument("--native", action="store_true",
+                    help="Channel in native code (channel.h via libphonocrypt) instead of Tester.py's Python loops")
+    ap.add_argument("--lib", default=None, help="libphonocrypt.so for --in-memory/--native (default: next to phonocrypt.py)")
+    ap.add_argument("--sync-check", action="store_true",
+                    help="Only decode in-memory frames behind decoy preambles (through the library) and exit")
     args = ap.parse_args()
+    if args.lib:
+        os.environ["PHONOCRYPT_LIB"] = args.lib
 
     # Make paths relative to this script's directory (fixes 'I ran it from another cwd' nonsense)
     root = Path(__file__).resolve().parent
+    if args.sync_check:
+        sys.path.insert(0, str(root))
+        sys.exit(run_sync_check(args.lib))
 
     sender_path = (root / args.sender).resolve() if not Path(args.sender).is_absolute() else Path(args.sender)
     receiver_path = (root / args.receiver).resolve() if not Path(args.receiver).is_absolute() else Path(args.receiver)
@@ -107,7 +258,10 @@ def main():
         cover_path = (root / args.cover).resolve() if not Path(args.cover).is_absolute() else Path(args.cover)
 
     # Checks
-    for p, name in [(sender_path, "sender"), (receiver_path, "receiver")]:
+    tools = [(sender_path, "sender"), (receiver_path, "receiver")]
+    if args.in_memory:
+        tools = [(sender_path, "sender")] if cover_path else []
+    for p, name in tools:
         if not p.exists():
             print(f"[ERR] {name} not found: {p}")
             sys.exit(2)
@@ -135,6 +289,20 @@ def main():
         cases_path = (root / args.cases).resolve() if not Path(args.cases).is_absolute() else Path(args.cases)
         data = json.loads(cases_path.read_text(encoding="utf-8"))
         cases = [Case(**c) for c in data["cases"]]
+    if args.grid:
+        cases = grid_cases(args.grid, args.seed)
+
+    if args.in_memory:
+        for case_name, r, err in run_in_memory(cases, plaintext, root, sender_path, cover_path, tester_path,
+                                               args.lib, args.native, max(1, args.jobs), args.timeout):
+            ok = bool(r and r.get("ok"))
+            sim = similarity_quick(plaintext, r["message"]) if ok else 0.0
+            exact = ok and normalize_text(r["message"]) == normalize_text(plaintext)
+            rc = 998 if r is None else (0 if ok else 1)
+            tag = "PASS ✅" if exact else "FAIL ❌"
+            why = err or ("" if ok else (r.get("error") or "").split("\n")[0])
+            print(f"{tag}  {case_name:<35}  sim={sim:.4f}  rc={rc}  {why}")
+        return
 
     run_id = datetime.now().strftime("%Y%m%d_%H%M%S")
     out_root = root / args.outdir / run_id
@@ -158,10 +326,6 @@ def main():
     base_copy = out_root / "00_base_encoded_signal.wav"
     shutil.copy2(base_wav, base_copy)
 
-    # 2) Receiver on base: sanity check
-    rc_b, so_b, se_b = run_cmd([str(receiver_path), str(base_copy)], cwd=root, timeout=args.timeout)
-    dec_base = parse_receiver_decrypted(so_b) if rc_b == 0 else ""
-
     def evaluate(case_name: str, wav_path: Path, receiver_rc: int, dec_text: str, receiver_stderr: str):
         dec_norm = normalize_text(dec_text)
         src_norm = normalize_text(plaintext)
@@ -179,11 +343,11 @@ def main():
         }
 
     results = []
-    results.append(evaluate("base", base_copy, rc_b, dec_base, se_b))
+    decode_jobs = [("base", base_copy)]
 
-    # 3) Stress: apply Tester.py -> save WAV -> run receiver -> compare
+    # 2) Stress: apply Tester.py -> save WAV (decoded together below)
     for idx, c in enumerate(cases, start=1):
-        case_name = slug(f"{idx:02d}_{c.preset}_{c.noise}_snr{c.snr:g}_seed{c.seed}")
+        case_name = case_slug(idx, c)
         stressed_wav = out_root / f"{case_name}.wav"
 
         tester_cmd = [
@@ -194,7 +358,7 @@ def main():
             "--noise", c.noise,
             "--snr", str(c.snr),
             "--seed", str(c.seed),
-        ]
+        ] + (["--native"] if args.native else [])
 
         print(f"[*] Channel: {case_name}")
         rc_t, so_t, se_t = run_cmd(tester_cmd, cwd=root, timeout=args.timeout)
@@ -212,11 +376,27 @@ def main():
             })
             continue
 
-        rc_r, so_r, se_r = run_cmd([str(receiver_path), str(stressed_wav)], cwd=root, timeout=args.timeout)
+        decode_jobs.append((case_name, stressed_wav))
 
-        dec = parse_receiver_decrypted(so_r) if rc_r == 0 else ""
+    # 3) One receiver process decodes every WAV (one JSON result line per file)
+    batch_cmd = [str(receiver_path), "--batch"] + [str(w) for _, w in decode_jobs]
+    rc_r, so_r, se_r = run_cmd(batch_cmd, cwd=root, timeout=args.timeout * len(decode_jobs))
+    by_file = {}
+    for line in so_r.splitlines():
+        try:
+            r = json.loads(line)
+        except ValueError:
+            continue
+        by_file[r.get("file")] = r
 
-        results.append(evaluate(case_name, stressed_wav, rc_r, dec, se_r))
+    # 4) Compare with plaintext
+    for case_name, wav in decode_jobs:
+        r = by_file.get(str(wav))
+        if r is None:
+            results.append(evaluate(case_name, wav, 998, "", f"no batch result (rc={rc_r}): {se_r}"))
+            continue
+        ok = bool(r.get("ok"))
+        results.append(evaluate(case_name, wav, 0 if ok else 1, r.get("message", "") if ok else "", r.get("error", "")))
 
     # 5) Print a quick pass/fail report
     for r in results:
@@ -247,18 +247,25 @@ def main():
                    help="noise type (default: mix)")
     p.add_argument("--snr", type=float, default=18.0, help="SNR in dB (default: 18)")
     p.add_argument("--seed", type=int, default=123, help="random seed (default: 123)")
+    p.add_argument("--native", action="store_true",
+                   help="run the impairments in libphonocrypt (channel.h): same models, other random streams")
     args = p.parse_args()
 
     audio, fs = sf.read(args.in_wav, dtype="float32")
     x = to_mono(audio)
 
-    rng = np.random.default_rng(args.seed)
+    if args.native:
+        import phonocrypt
+        y = phonocrypt.channel(np.ascontiguousarray(x), fs, args.preset, args.noise, args.snr, args.seed,
+                               alloc=lambda n: np.empty(n, dtype=np.float32))
+    else:
+        rng = np.random.default_rng(args.seed)
 
-    # 1) compression-like damage
-    y = apply_compression_preset(x, fs, args.preset)
+        # 1) compression-like damage
+        y = apply_compression_preset(x, fs, args.preset)
 
-    # 2) noise damage
-    y = apply_noise(y, fs, args.noise, args.snr, rng)
+        # 2) noise damage
+        y = apply_noise(y, fs, args.noise, args.snr, rng)
 
     sf.write(args.out_wav, y, fs, subtype="PCM_16")
     print(f"OK: wrote {args.out_wav} (preset={args.preset}, noise={args.noise}, snr={args.snr} dB, fs={fs}, seed={args.seed})")
@@ -0,0 +1,384 @@
+/*
+ * bench.c - per-stage benchmark of the sender and receiver DSP
+ * Usage:
+ *   ./bench [--bytes N] [--fec rep|conv] [--mod bfsk|4fsk|8fsk|mc4] [--packets]
+ *           [--rate 15ms|10ms|7.5ms|5ms|3.75ms] [--snr DB] [--lead SEC] [--cover-rate HZ] [--adaptive]
+ *           [--reps N] [--threads N] [--seed N] [--scalar] [--decimate]
+ * Build: against the library like the other tools; the sender stages run
+ * the encoder and the sender's cover mixer (cover.h), the receiver stages
+ * are timed by the decoder's own telemetry (rxstats.h, as receiver --stats):
+ *   gcc -O2 bench.c phonocrypt.c -o bench -lsndfile -lssl -lcrypto -lm -lpthread
+ *
+ * A random message of --bytes (default 256) is framed, encrypted and
+ * modulated in memory. It is preceded by --lead seconds (default 0.5) of
+ * noise, gets white noise at --snr dB (default 20) and is then received:
+ *   synthesis   sender: preamble, header and body symbols pulled from the
+ *               encoder and clamped, as the sender writes them
+ *   cover_mix   sender: a synthetic stereo cover at --cover-rate, read
+ *               (looped, resampled if not 44.1 kHz) and mixed
+ *   load        receiver: taking in the signal
+ *   frontend    receiver: DC / RMS stats and band-pass
+ *   decimate    receiver: polyphase resampler (--decimate only)
+ *   search      receiver: envelope regions + coarse offset scan
+ *   sweep       receiver: exhaustive sliding-DFT sweep (sync fallback), of
+ *               the same noise without the frame so that it runs
+ *   refine      receiver: preamble/MAGIC boundary + STEG refinement
+ *   demod       receiver: header bits and body symbol LLRs
+ *   fec         receiver: channel decoder
+ *   crc         CRC-32 of a frame's header, IV and ciphertext (crc32.h)
+ *   decrypt     receiver: AES-256-CTR over the ciphertext
+ *   receive     receiver: the whole-file decode end to end (no telemetry)
+ * Sender stages, crc and receive are the best of --reps runs (short ones
+ * repeated to >= 1 ms); the other receiver stages are the best over --reps
+ * decodes of the stage's exclusive time. Output is one JSON object: the
+ * configuration, "ok" (message recovered) and per stage ns, samples/s,
+ * bits/s and ns/sample. Sender stages count frame samples, receiver stages
+ * the received signal, bits are message bits, so figures compare across
+ * versions for the same options.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sndfile.h>
+#include "phonocrypt.h"
+#include "cover.h"
+#include "crc32.h"
+
+#define SAMPLE_RATE         PC_SAMPLE_RATE
+#define BENCH_COVER_SECONDS 10     /* synthetic cover, looped */
+#define BENCH_MIN_NS        1e6    /* shortest timed run */
+#define BENCH_MAX_STAGES    16
+
+static double bench_now(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec * 1e9 + (double)t.tv_nsec;
+}
+
+/* xorshift64* and Box-Muller: noise that does not depend on libc rand() */
+static uint64_t bench_rng = 0x9E3779B97F4A7C15ull;
+
+static double bench_uniform(void){
+    bench_rng ^= bench_rng >> 12;
+    bench_rng ^= bench_rng << 25;
+    bench_rng ^= bench_rng >> 27;
+    return ((double)((bench_rng * 0x2545F4914F6CDD1Dull) >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static double bench_gauss(void){
+    return sqrt(-2.0 * log(bench_uniform())) * cos(2.0 * M_PI * bench_uniform());
+}
+
+/* ---------- State shared by the stages ---------- */
+typedef struct {
+    /* sender */
+    pc_encoder_config ec;
+    const char *msg;
+    int bytes;
+    pc_encoder *enc;
+    float *sig;                  /* synthesized frame, sig_n samples */
+    long long sig_n, sig_cap;
+    int err;                     /* PC_* of the last encoder call */
+    cover_src cover;
+    float *mix, *cbuf;
+    int adaptive;
+
+    /* receiver */
+    pc_decoder_config dc;
+    float *rx;                   /* received signal, rx_n samples */
+    float *quiet;                /* its noise alone */
+    long long rx_n;
+    unsigned char *frame;        /* header, IV and ciphertext sized bytes (crc) */
+    unsigned char *plain;
+} bench_ctx;
+
+typedef void (*stage_fn)(bench_ctx *b);
+
+typedef struct {
+    const char *name;
+    double ns;
+    long long samples;
+} stage_time;
+
+/* Best of reps; a run shorter than BENCH_MIN_NS is repeated inside the
+ * timing. prep (untimed) restores the input of stages that work in place;
+ * those run once per timing. */
+static double time_stage(bench_ctx *b, stage_fn fn, stage_fn prep, int reps){
+    int inner = 1;
+    if(!prep){
+        double t = bench_now();
+        fn(b);
+        t = bench_now() - t;
+        if(t < BENCH_MIN_NS) inner = (int)(BENCH_MIN_NS / (t > 1.0 ? t : 1.0)) + 1;
+    }
+    double best = 1e300;
+    for(int r=0;r<reps;r++){
+        if(prep) prep(b);
+        double t = bench_now();
+        for(int i=0;i<inner;i++) fn(b);
+        t = (bench_now() - t) / inner;
+        if(t < best) best = t;
+    }
+    return best;
+}
+
+/* ---------- Sender stages ---------- */
+/* a fresh encoder of the message, framed and encrypted (untimed) */
+static void prep_synthesis(bench_ctx *b){
+    pc_encoder_free(b->enc);
+    b->enc = pc_encoder_new(&b->ec);
+    b->err = b->enc ? pc_encoder_push(b->enc, b->msg, (size_t)b->bytes) : PC_ENOMEM;
+    if(b->err == PC_OK) b->err = pc_encoder_start(b->enc);
+}
+
+/* pulled and clamped a TX block at a time, as the sender does */
+static void st_synthesis(bench_ctx *b){
+    long n;
+    b->sig_n = 0;
+    if(b->err) return;
+    while((n = pc_encoder_pull(b->enc, b->sig + b->sig_n, COVER_BLOCK)) != 0){
+        if(n < 0){ b->err = (int)n; break; }
+        for(long i=0;i<n;i++) b->sig[b->sig_n + i] = cover_clamp(b->sig[b->sig_n + i]);
+        b->sig_n += n;
+    }
+}
+
+static void prep_mix(bench_ctx *b){
+    memcpy(b->mix, b->sig, (size_t)b->sig_n*sizeof(float));
+}
+
+static void st_cover_mix(bench_ctx *b){
+    for(long long i=0;i<b->sig_n;i+=COVER_BLOCK){
+        int k = (b->sig_n - i < COVER_BLOCK) ? (int)(b->sig_n - i) : COVER_BLOCK;
+        cover_mix(&b->cover, b->cbuf, b->mix + i, k, b->adaptive);
+    }
+}
+
+/* Stereo PCM16 cover at fs: a few partials with a slow envelope and some
+ * noise, written to a temporary file that is unlinked once open */
+static int bench_cover(cover_src *c, int fs){
+    char path[] = "/tmp/phonocrypt-bench-XXXXXX";
+    int fd = mkstemp(path);
+    if(fd < 0) return -1;
+    close(fd);
+
+    SF_INFO info; memset(&info,0,sizeof(info));
+    info.samplerate = fs;
+    info.channels = 2;
+    info.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+    SNDFILE *f = sf_open(path, SFM_WRITE, &info);
+    float blk[2*1024];
+    long long total = (long long)BENCH_COVER_SECONDS * fs;
+    for(long long i=0;f && i<total;i+=1024){
+        for(int k=0;k<1024;k++){
+            double t = (double)(i + k) / fs;
+            double env = 0.5 + 0.4 * sin(2.0*M_PI*0.3*t);
+            double v = env * (0.3*sin(2.0*M_PI*220.0*t) + 0.2*sin(2.0*M_PI*330.0*t) + 0.1*sin(2.0*M_PI*1760.0*t));
+            blk[2*k] = (float)(v + 0.02*bench_gauss());
+            blk[2*k+1] = (float)(0.8*v + 0.02*bench_gauss());
+        }
+        sf_write_float(f, blk, 2*1024);
+    }
+    int rc = f ? 0 : -1;
+    if(f) sf_close(f);
+    if(rc == 0) rc = cover_open(c, path);
+    unlink(path);
+    return rc;
+}
+
+/* ---------- Receiver stages ---------- */
+/* One whole-mode decode of x with the bench's options; telemetry (stats
+ * set in b->dc) into *st. 1 if the message came back, 0 if not, -1 if the
+ * decoder failed. */
+static int bench_decode(bench_ctx *b, const float *x, rx_stats *st){
+    pc_decoder *d = pc_decoder_new(&b->dc);
+    if(!d) return -1;
+    int rc = pc_decoder_push(d, x, b->rx_n);
+    if(rc == PC_OK) rc = pc_decoder_finish(d);
+    pc_info info;
+    pc_decoder_info(d, &info);
+    long k = (rc == PC_OK && info.plain > 0) ? pc_decoder_pull(d, b->plain, b->bytes) : 0;
+    if(st && info.stats) *st = *info.stats;
+    pc_decoder_free(d);
+    if(rc != PC_OK) return -1;
+    return info.ok && k == b->bytes && memcmp(b->plain, b->msg, (size_t)b->bytes) == 0;
+}
+
+static void st_receive(bench_ctx *b){
+    bench_decode(b, b->rx, NULL);
+}
+
+static void st_crc(bench_ctx *b){
+    volatile uint32_t c = crc32_update(crc32_update(0, b->frame, 8), b->frame + 8, PC_IV_LEN);
+    c = crc32_update(c, b->frame + 8 + PC_IV_LEN, (size_t)b->bytes);
+    (void)c;
+}
+
+static void json_stage(const stage_time *s, int first, int bits){
+    double sec = s->ns * 1e-9;
+    printf("%s\"%s\":{\"ns\":%.0f,\"samples\":%lld,\"samples_per_s\":%.4g,\"bits_per_s\":%.4g,\"ns_per_sample\":%.4g}",
+           first ? "" : ",", s->name, s->ns, s->samples, (double)s->samples / sec, (double)bits / sec,
+           s->ns / (double)s->samples);
+}
+
+int main(int argc, char **argv){
+    int bytes = 256, code = PC_FEC_CONV, mod = PC_MOD_BFSK, packets = 0, reps = 5, cover_rate = SAMPLE_RATE;
+    int adaptive = 0, threads = 1, simd = 1, decimate = 0, rate = PC_RATE_15MS;
+    double snr_db = 20.0, lead = 0.5;
+
+    for(int i=1;i<argc;i++){
+        const char *a = argv[i], *v = (i+1 < argc) ? argv[i+1] : NULL;
+        if(strcmp(a, "--packets") == 0) packets = 1;
+        else if(strcmp(a, "--adaptive") == 0) adaptive = 1;
+        else if(strcmp(a, "--scalar") == 0) simd = 0;
+        else if(strcmp(a, "--decimate") == 0) decimate = 1;
+        else if(v && strcmp(a, "--bytes") == 0){ bytes = atoi(v); i++; }
+        else if(v && strcmp(a, "--reps") == 0){ reps = atoi(v); i++; }
+        else if(v && strcmp(a, "--threads") == 0){ threads = atoi(v); i++; }
+        else if(v && strcmp(a, "--seed") == 0){ bench_rng ^= strtoull(v, NULL, 10) * 0xD1B54A32D192ED03ull; i++; }
+        else if(v && strcmp(a, "--snr") == 0){ snr_db = atof(v); i++; }
+        else if(v && strcmp(a, "--lead") == 0){ lead = atof(v); i++; }
+        else if(v && strcmp(a, "--cover-rate") == 0){ cover_rate = atoi(v); i++; }
+        else if(v && strcmp(a, "--fec") == 0){
+            code = pc_fec_find(v);
+            i++;
+        }
+        else if(v && strcmp(a, "--mod") == 0){ mod = pc_mod_find(v); i++; }
+        else if(v && strcmp(a, "--rate") == 0){ rate = pc_rate_find(v); i++; }
+        else code = -2;
+        if(code < 0 || mod < 0 || rate < 0) break;
+    }
+    if(code < 0 || mod < 0 || rate < 0 || !pc_rate_fits(rate, mod) || bytes < 1 || bytes > PC_MAX_LEN || reps < 1
+       || threads < 1 || lead < 0.0 || cover_rate <= 0){
+        fprintf(stderr, "Usage: %s [--bytes N] [--fec rep|conv] [--mod bfsk|4fsk|8fsk|mc4] [--packets]\n"
+                        "          [--rate 15ms|10ms|7.5ms|5ms|3.75ms] [--snr DB] [--lead SEC] [--cover-rate HZ] [--adaptive]\n"
+                        "          [--reps N] [--threads N] [--seed N] [--scalar] [--decimate]\n", argv[0]);
+        return 1;
+    }
+    if(bench_rng == 0) bench_rng = 1;
+
+    bench_ctx b;
+    memset(&b, 0, sizeof(b));
+    b.adaptive = adaptive;
+    b.bytes = bytes;
+
+    /* frame of a random printable message */
+    char *msg = (char*)malloc((size_t)bytes + 1);
+    if(!msg){ fprintf(stderr, "Setup failed\n"); return 1; }
+    for(int i=0;i<bytes;i++) msg[i] = (char)(' ' + (int)(bench_uniform() * 95.0));
+    msg[bytes] = 0;
+    b.msg = msg;
+    pc_encoder_defaults(&b.ec);
+    b.ec.fec = code;
+    b.ec.mod = mod;
+    b.ec.rate = rate;
+    b.ec.packets = packets;
+    prep_synthesis(&b);
+    if(b.err != PC_OK){ fprintf(stderr, "Setup failed: %s\n", pc_strerror(b.err)); return 1; }
+
+    b.sig_cap = pc_encoder_length(b.enc);
+    b.sig = (float*)malloc((size_t)b.sig_cap*sizeof(float));
+    if(!b.sig){
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    stage_time st[BENCH_MAX_STAGES];
+    int ns = 0;
+
+    st[ns].name = "synthesis";
+    st[ns].ns = time_stage(&b, st_synthesis, prep_synthesis, reps);
+    st[ns++].samples = b.sig_n;
+    if(b.err || b.sig_n != b.sig_cap){ fprintf(stderr, "Synthesis failed\n"); return 1; }
+
+    b.mix = (float*)malloc((size_t)b.sig_n*sizeof(float));
+    b.cbuf = (float*)malloc((size_t)COVER_BLOCK*sizeof(float));
+    if(!b.mix || !b.cbuf || bench_cover(&b.cover, cover_rate) != 0){ fprintf(stderr, "Cover setup failed\n"); return 1; }
+    st[ns].name = "cover_mix";
+    st[ns].ns = time_stage(&b, st_cover_mix, prep_mix, reps);
+    st[ns++].samples = b.sig_n;
+
+    /* received signal: lead + frame + lead, white noise at snr_db; quiet
+     * is the same noise alone */
+    long long lead_n = (long long)llround(lead * SAMPLE_RATE);
+    b.rx_n = lead_n + b.sig_n + lead_n;
+    b.rx = (float*)calloc((size_t)b.rx_n, sizeof(float));
+    b.quiet = (float*)malloc((size_t)b.rx_n*sizeof(float));
+    b.frame = (unsigned char*)malloc((size_t)bytes + 8 + PC_IV_LEN);
+    b.plain = (unsigned char*)malloc((size_t)bytes + 1);
+    if(!b.rx || !b.quiet || !b.frame || !b.plain){ fprintf(stderr, "Out of memory\n"); return 1; }
+    double p = 0.0;
+    for(long long i=0;i<b.sig_n;i++){ b.rx[lead_n + i] = b.sig[i]; p += (double)b.sig[i]*b.sig[i]; }
+    double sigma = sqrt(p / (double)b.sig_n / pow(10.0, snr_db / 10.0));
+    for(long long i=0;i<b.rx_n;i++){
+        b.quiet[i] = (float)(sigma * bench_gauss());
+        b.rx[i] += b.quiet[i];
+    }
+    for(int i=0;i<bytes + 8 + PC_IV_LEN;i++) b.frame[i] = (unsigned char)(bench_uniform() * 256.0);
+
+    pc_decoder_defaults(&b.dc);
+    b.dc.samplerate = SAMPLE_RATE;
+    b.dc.channels = 1;
+    b.dc.frames = b.rx_n;
+    b.dc.threads = threads;
+    b.dc.decimate = decimate;
+    b.dc.scalar = !simd;
+    b.dc.stats = 1;
+
+    /* receiver stages: exclusive stage times, best per stage */
+    static const struct { const char *name; int stage; } rx_st[] = {
+        { "load", RXS_LOAD }, { "frontend", RXS_FRONTEND }, { "decimate", RXS_DECIMATE },
+        { "search", RXS_SEARCH }, { "sweep", RXS_SWEEP }, { "refine", RXS_REFINE },
+        { "demod", RXS_DEMOD }, { "fec", RXS_FEC }, { "crc", -1 }, { "decrypt", RXS_DECRYPT },
+    };
+    double best[RXS_COUNT];
+    for(int i=0;i<RXS_COUNT;i++) best[i] = 1e300;
+    int ok = 1;
+    for(int r=0;r<reps;r++){
+        rx_stats s, q;
+        int got = bench_decode(&b, b.rx, &s);
+        if(got < 0 || bench_decode(&b, b.quiet, &q) < 0 || q.sweeps == 0){ fprintf(stderr, "Decode failed\n"); return 1; }
+        ok &= got;
+        for(int i=0;i<RXS_COUNT;i++){
+            double v = (double)((i == RXS_SWEEP) ? q.ns[i] : s.ns[i]);
+            if(v < best[i]) best[i] = v;
+        }
+    }
+    for(size_t i=0;i<sizeof(rx_st)/sizeof(rx_st[0]);i++){
+        if(rx_st[i].stage == RXS_DECIMATE && !decimate) continue;
+        st[ns].name = rx_st[i].name;
+        st[ns].ns = (rx_st[i].stage < 0) ? time_stage(&b, st_crc, NULL, reps) : best[rx_st[i].stage];
+        st[ns++].samples = b.rx_n;
+    }
+    b.dc.stats = 0;
+    st[ns].name = "receive";
+    st[ns].ns = time_stage(&b, st_receive, NULL, reps);
+    st[ns++].samples = b.rx_n;
+
+    printf("{\"bench\":\"phonocrypt\",\"fs\":%d,\"bytes\":%d,\"fec\":\"%s\",\"mod\":\"%s\",\"rate\":\"%s\","
+           "\"packets\":%s,\"snr_db\":%.1f,\"lead_s\":%.2f,\"cover_rate\":%d,\"adaptive\":%s,\"decimate\":%s,\"simd\":%s,"
+           "\"threads\":%d,\"reps\":%d,\"frame_samples\":%lld,\"rx_samples\":%lld,\"ok\":%s,\"stages\":{",
+           SAMPLE_RATE, bytes, pc_fec_name(code), pc_mod_name(mod), pc_rate_name(rate),
+           packets ? "true" : "false", snr_db, lead, cover_rate, adaptive ? "true" : "false",
+           decimate ? "true" : "false", simd ? "true" : "false", threads, reps, b.sig_n, b.rx_n, ok ? "true" : "false");
+    for(int i=0;i<ns;i++) json_stage(&st[i], i == 0, 8 * bytes);
+    printf("}}\n");
+
+    pc_cleanup();
+    cover_close(&b.cover);
+    pc_encoder_free(b.enc);
+    free(b.plain);
+    free(b.frame);
+    free(b.quiet);
+    free(b.rx);
+    free(b.cbuf);
+    free(b.mix);
+    free(b.sig);
+    free(msg);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+/*
+ * channel.c - channel stress test: codec-like compression + noise
+ * Usage (as Tester.py):
+ *   ./channel in.wav out.wav [--preset none|voip|pstn|lowbit]
+ *             [--noise awgn|pink|hum|clicks|mix] [--snr DB] [--seed N]
+ *
+ * Defaults voip, mix, 18 dB, seed 123. The input is downmixed to mono,
+ * the output written as PCM 16-bit at the input rate. The impairments are
+ * channel.h's, in the native block loops instead of Python per-sample ones.
+ *   gcc -O2 channel.c -o channel -lsndfile -lm
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sndfile.h>
+#include "channel.h"
+
+static int usage(const char *argv0){
+    fprintf(stderr, "Usage: %s in.wav out.wav [--preset none|voip|pstn|lowbit]\n"
+                    "          [--noise awgn|pink|hum|clicks|mix] [--snr DB] [--seed N]\n", argv0);
+    return 2;
+}
+
+int main(int argc, char **argv){
+    const char *in_path = NULL, *out_path = NULL;
+    int preset = CHAN_VOIP, noise = CHAN_MIX;
+    double snr_db = 18.0;
+    unsigned long long seed = 123;
+
+    for(int i=1;i<argc;i++){
+        const char *a = argv[i], *v = (i+1 < argc) ? argv[i+1] : NULL;
+        if(v && strcmp(a, "--preset") == 0){ preset = chan_find(chan_preset_names, v); i++; }
+        else if(v && strcmp(a, "--noise") == 0){ noise = chan_find(chan_noise_names, v); i++; }
+        else if(v && strcmp(a, "--snr") == 0){ snr_db = atof(v); i++; }
+        else if(v && strcmp(a, "--seed") == 0){ seed = strtoull(v, NULL, 10); i++; }
+        else if(a[0] == '-' && a[1] == '-') return usage(argv[0]);
+        else if(!in_path) in_path = a;
+        else if(!out_path) out_path = a;
+        else return usage(argv[0]);
+        if(preset < 0){ fprintf(stderr, "Unknown preset. Use: none|voip|pstn|lowbit\n"); return 2; }
+        if(noise < 0){ fprintf(stderr, "Unknown noise type. Use: awgn|pink|hum|clicks|mix\n"); return 2; }
+    }
+    if(!out_path) return usage(argv[0]);
+
+    SF_INFO info;
+    memset(&info, 0, sizeof(info));
+    SNDFILE *in = sf_open(in_path, SFM_READ, &info);
+    if(!in){ fprintf(stderr, "Cannot open %s: %s\n", in_path, sf_strerror(NULL)); return 1; }
+    long long n = (long long)info.frames;
+    int ch = info.channels, fs = info.samplerate;
+    float *frames = (float*)malloc((size_t)(n > 0 ? n : 1)*(size_t)ch*sizeof(float));
+    float *x = (float*)malloc((size_t)(n > 0 ? n : 1)*sizeof(float));
+    if(!frames || !x){ fprintf(stderr, "Out of memory\n"); return 1; }
+    n = (long long)sf_readf_float(in, frames, (sf_count_t)n);
+    sf_close(in);
+    for(long long i=0;i<n;i++){
+        double sum = 0.0;
+        for(int c=0;c<ch;c++) sum += frames[i*ch + c];
+        x[i] = (float)(sum / ch);
+    }
+    free(frames);
+
+    long long m = chan_out_len(n, fs, preset);
+    float *y = (float*)malloc((size_t)(m > 0 ? m : 1)*sizeof(float));
+    if(!y || chan_apply(preset, noise, snr_db, seed, x, n, fs, y) != 0){ fprintf(stderr, "Out of memory\n"); return 1; }
+    free(x);
+
+    SF_INFO oi;
+    memset(&oi, 0, sizeof(oi));
+    oi.samplerate = fs;
+    oi.channels = 1;
+    oi.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+    SNDFILE *out = sf_open(out_path, SFM_WRITE, &oi);
+    if(!out){ fprintf(stderr, "Cannot write %s: %s\n", out_path, sf_strerror(NULL)); return 1; }
+    if(sf_writef_float(out, y, (sf_count_t)m) != (sf_count_t)m){
+        fprintf(stderr, "Write failed: %s\n", sf_strerror(out));
+        sf_close(out);
+        return 1;
+    }
+    sf_close(out);
+    free(y);
+
+    printf("OK: wrote %s (preset=%s, noise=%s, snr=%g dB, fs=%d, seed=%llu)\n",
+           out_path, chan_preset_names[preset], chan_noise_names[noise], snr_db, fs, seed);
+    return 0;
+}
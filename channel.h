@@ -0,0 +1,345 @@
+/*
+ * channel.h - native channel simulator (Tester.py's impairments)
+ *
+ * Presets none|voip|pstn|lowbit (telephony band limit, linear-interpolated
+ * rate change, quantizer or G.711 mu-law, back to the input rate) and
+ * noise awgn|pink|hum|clicks|mix at an SNR, with Tester.py's parameters
+ * and order. The filters run CHAN_BLOCK samples at a time with their
+ * state carried across blocks, mu-law is two table lookups, hum tones are
+ * rotating phasors re-anchored every block. The random streams are
+ * xoshiro256** rather than numpy's, so results match Tester.py
+ * statistically, not sample for sample. Used by libphonocrypt
+ * (pc_channel_apply) and the channel tool.
+ */
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define CHAN_BLOCK      4096
+
+#define CHAN_NONE       0
+#define CHAN_VOIP       1
+#define CHAN_PSTN       2
+#define CHAN_LOWBIT     3
+
+#define CHAN_AWGN       0
+#define CHAN_PINK       1
+#define CHAN_HUM        2
+#define CHAN_CLICKS     3
+#define CHAN_MIX        4
+
+static const char *const chan_preset_names[] = { "none", "voip", "pstn", "lowbit", NULL };
+static const char *const chan_noise_names[] = { "awgn", "pink", "hum", "clicks", "mix", NULL };
+
+static inline int chan_find(const char *const *names, const char *name){
+    for(int i=0;names[i];i++) if(strcmp(names[i], name) == 0) return i;
+    return -1;
+}
+
+/* ---- Random numbers: xoshiro256**, seeded through splitmix64 ---- */
+typedef struct {
+    uint64_t s[4];
+    int has_g;
+    double g;                    /* second normal of the last polar pair */
+} chan_rng;
+
+static inline void chan_rng_seed(chan_rng *r, uint64_t seed){
+    for(int i=0;i<4;i++){
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        r->s[i] = z ^ (z >> 31);
+    }
+    r->has_g = 0;
+}
+
+static inline uint64_t chan_rng_next(chan_rng *r){
+    uint64_t *s = r->s;
+    uint64_t x = s[1] * 5, out = ((x << 7) | (x >> 57)) * 9, t = s[1] << 17;
+    s[2] ^= s[0]; s[3] ^= s[1]; s[1] ^= s[2]; s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+    return out;
+}
+
+/* [0,1) */
+static inline double chan_uniform(chan_rng *r){
+    return (double)(chan_rng_next(r) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* N(0,1), Marsaglia polar */
+static inline double chan_gauss(chan_rng *r){
+    if(r->has_g){ r->has_g = 0; return r->g; }
+    double u, v, s;
+    do {
+        u = 2.0*chan_uniform(r) - 1.0;
+        v = 2.0*chan_uniform(r) - 1.0;
+        s = u*u + v*v;
+    } while(s >= 1.0 || s == 0.0);
+    double k = sqrt(-2.0*log(s)/s);
+    r->g = v*k;
+    r->has_g = 1;
+    return u*k;
+}
+
+/* ---- Helpers ---- */
+static inline double chan_rms(const float *x, long long n){
+    double acc = 0.0;
+    for(long long i=0;i<n;i++) acc += (double)x[i]*x[i];
+    return (n > 0 ? sqrt(acc / (double)n) : 0.0) + 1e-12;
+}
+
+static inline void chan_clamp(float *x, long long n){
+    for(long long i=0;i<n;i++){
+        float v = x[i];
+        v = (v > 1.0f) ? 1.0f : v;
+        x[i] = (v < -1.0f) ? -1.0f : v;
+    }
+}
+
+/* x += g * y, clamped */
+static inline void chan_add(float *x, const float *y, long long n, float g){
+    for(long long i=0;i<n;i++) x[i] += g * y[i];
+    chan_clamp(x, n);
+}
+
+/* ---- RBJ biquads, transposed direct form II ---- */
+typedef struct {
+    double b0,b1,b2,a1,a2;
+    double z1,z2;
+} chan_biquad;
+
+static inline chan_biquad chan_rbj(int fs, double f0, int highpass){
+    double w0 = 2.0*M_PI*f0/(double)fs;
+    double alpha = sin(w0)/(2.0*0.707);
+    double c = cos(w0);
+    double a0 = 1.0 + alpha;
+    double b0 = highpass ? (1.0 + c)/2.0 : (1.0 - c)/2.0;
+    double b1 = highpass ? -(1.0 + c) : 1.0 - c;
+    chan_biquad q = { b0/a0, b1/a0, b0/a0, (-2.0*c)/a0, (1.0 - alpha)/a0, 0.0, 0.0 };
+    return q;
+}
+
+static inline void chan_biquad_run(chan_biquad *q, float *x, long long n){
+    double b0=q->b0, b1=q->b1, b2=q->b2, a1=q->a1, a2=q->a2;
+    double z1=q->z1, z2=q->z2;
+    for(long long i=0;i<n;i++){
+        double xi = x[i];
+        double yi = b0*xi + z1;
+        z1 = b1*xi - a1*yi + z2;
+        z2 = b2*xi - a2*yi;
+        x[i] = (float)yi;
+    }
+    q->z1 = z1; q->z2 = z2;
+}
+
+/* High-pass at lo then low-pass at hi, in place; both stages run on each
+ * block while it is in cache */
+static inline void chan_bandlimit(float *x, long long n, int fs, double lo, double hi){
+    chan_biquad hp = chan_rbj(fs, lo, 1), lp = chan_rbj(fs, hi, 0);
+    for(long long i=0;i<n;i+=CHAN_BLOCK){
+        long long k = (n - i < CHAN_BLOCK) ? n - i : CHAN_BLOCK;
+        chan_biquad_run(&hp, x + i, k);
+        chan_biquad_run(&lp, x + i, k);
+    }
+}
+
+/* ---- Rate change (numpy.interp over the same time grids) ---- */
+static inline long long chan_resample_len(long long n, int fs_in, int fs_out){
+    if(fs_in == fs_out) return n;
+    long long m = llrint((double)n / (double)fs_in * (double)fs_out);
+    return (m <= 1) ? (n < 1 ? n : 1) : m;
+}
+
+static inline void chan_resample(const float *x, long long n, int fs_in, int fs_out, float *y){
+    long long m = chan_resample_len(n, fs_in, fs_out);
+    if(m == n || m <= 1){ memcpy(y, x, (size_t)m*sizeof(float)); return; }
+    double step = (double)n / (double)m;
+    for(long long j=0;j<m;j++){
+        double p = (double)j * step;
+        long long i = (long long)p;
+        if(i >= n - 1){ y[j] = x[n-1]; continue; }
+        double f = p - (double)i;
+        y[j] = (float)((double)x[i] + f*((double)x[i+1] - (double)x[i]));
+    }
+}
+
+/* ---- Quantizers ---- */
+static inline void chan_quantize(float *x, long long n, int bits){
+    if(bits >= 16) return;
+    chan_clamp(x, n);
+    float levels = (float)((1 << bits) - 1);
+    for(long long i=0;i<n;i++){
+        float y = nearbyintf((x[i]*0.5f + 0.5f) * levels) / levels;
+        x[i] = (y - 0.5f) * 2.0f;
+    }
+    chan_clamp(x, n);
+}
+
+/* G.711 mu-law there and back: exponent from the top byte of the biased
+ * magnitude, the 256 codes decoded once */
+static inline void chan_mulaw(float *x, long long n){
+    uint8_t exp_lut[256];
+    float dec[256];
+    exp_lut[0] = 0;
+    for(int v=1;v<256;v++){ int e = 0; while((v >> (e+1)) != 0) e++; exp_lut[v] = (uint8_t)e; }
+    for(int u=0;u<256;u++){
+        int c = ~u & 0xFF;
+        int e = (c >> 4) & 0x07;
+        int mag = (((c & 0x0F) << 3) + 0x84) << e;
+        dec[u] = (float)((c & 0x80) ? -(mag - 0x84) : (mag - 0x84)) / 32767.0f;
+    }
+
+    for(long long i=0;i<n;i++){
+        float v = x[i];
+        v = (v > 1.0f) ? 1.0f : v;
+        v = (v < -1.0f) ? -1.0f : v;
+        int pcm = (int)nearbyintf(v * 32767.0f);
+        int sign = pcm < 0;
+        int mag = sign ? -pcm : pcm;
+        if(mag > 32635) mag = 32635;
+        mag += 0x84;
+        int e = exp_lut[(mag >> 7) & 0xFF];
+        int mant = (mag >> (e + 3)) & 0x0F;
+        x[i] = dec[~((sign << 7) | (e << 4) | mant) & 0xFF];
+    }
+}
+
+/* ---- Compression-ish presets ---- */
+static inline long long chan_out_len(long long n, int fs, int preset){
+    static const int low[] = { 0, 16000, 8000, 12000 };
+    if(preset == CHAN_NONE) return n;
+    return chan_resample_len(chan_resample_len(n, fs, low[preset]), low[preset], fs);
+}
+
+/* x[0..n) into out[0..chan_out_len); 0, or -1 out of memory */
+static inline int chan_preset(int preset, const float *x, long long n, int fs, float *out){
+    static const double lo[] = { 0, 80.0, 300.0, 120.0 }, hi[] = { 0, 7000.0, 3400.0, 6000.0 };
+    static const int low[] = { 0, 16000, 8000, 12000 };
+    if(preset == CHAN_NONE){ memcpy(out, x, (size_t)n*sizeof(float)); return 0; }
+
+    int fl = low[preset];
+    long long m = chan_resample_len(n, fs, fl);
+    float *y = (float*)malloc((size_t)(n > 0 ? n : 1)*sizeof(float));
+    float *z = (float*)malloc((size_t)(m > 0 ? m : 1)*sizeof(float));
+    if(!y || !z){ free(y); free(z); return -1; }
+
+    memcpy(y, x, (size_t)n*sizeof(float));
+    chan_bandlimit(y, n, fs, lo[preset], hi[preset]);
+    chan_resample(y, n, fs, fl, z);
+    if(preset == CHAN_VOIP) chan_quantize(z, m, 12);
+    else if(preset == CHAN_PSTN) chan_mulaw(z, m);
+    else chan_quantize(z, m, 8);
+    chan_resample(z, m, fl, fs, out);
+    chan_clamp(out, chan_out_len(n, fs, preset));
+    free(y);
+    free(z);
+    return 0;
+}
+
+/* ---- Noise, in place, scaled to snr_db below the signal's RMS ---- */
+static inline float chan_noise_gain(const float *x, long long n, double snr_db){
+    return (float)(chan_rms(x, n) / pow(10.0, snr_db / 20.0));
+}
+
+static inline void chan_awgn(float *x, long long n, double snr_db, chan_rng *r){
+    if(snr_db > 200) return;
+    float g = chan_noise_gain(x, n, snr_db);
+    for(long long i=0;i<n;i++) x[i] += g * (float)chan_gauss(r);
+    chan_clamp(x, n);
+}
+
+/* One-pole low-passed white noise, as Tester.py's pink */
+static inline void chan_pink(float *x, long long n, double snr_db, chan_rng *r, float *w){
+    if(snr_db > 200) return;
+    double acc = 0.0;
+    for(long long i=0;i<n;i++){
+        acc = 0.98*acc + 0.02*(double)(float)chan_gauss(r);
+        w[i] = (float)acc;
+    }
+    chan_add(x, w, n, (float)(chan_noise_gain(x, n, snr_db) / (chan_rms(w, n) + 1e-12)));
+}
+
+/* freq and its first harmonics at 1/k, one random phase */
+static inline void chan_hum(float *x, long long n, double snr_db, int fs, double freq, int harmonics, chan_rng *r, float *h){
+    if(snr_db > 200) return;
+    double phase = chan_uniform(r) * 2.0 * M_PI;
+    memset(h, 0, (size_t)n*sizeof(float));
+    for(int k=1;k<=harmonics;k++){
+        double w = 2.0*M_PI*freq*k/(double)fs, cw = cos(w), sw = sin(w);
+        for(long long i=0;i<n;i+=CHAN_BLOCK){
+            long long e = (n - i < CHAN_BLOCK) ? n - i : CHAN_BLOCK;
+            double c = cos(w*(double)i + phase), s = sin(w*(double)i + phase);
+            for(long long j=0;j<e;j++){
+                h[i+j] += (float)(s / k);
+                double t = c*cw - s*sw;
+                s = s*cw + c*sw;
+                c = t;
+            }
+        }
+    }
+    chan_add(x, h, n, (float)(chan_noise_gain(x, n, snr_db) / (chan_rms(h, n) + 1e-12)));
+}
+
+/* rate_hz decaying pulses of click_ms at random positions and amplitudes;
+ * one envelope table for all of them */
+static inline int chan_clicks(float *x, long long n, double snr_db, int fs, double rate_hz, double click_ms,
+                              chan_rng *r, float *c){
+    if(snr_db > 200) return 0;
+    long long expected = (long long)(rate_hz * ((double)n / fs));
+    long long L = (long long)(fs * (click_ms / 1000.0));
+    if(L < 1) L = 1;
+    float *env = (float*)malloc((size_t)L*sizeof(float));
+    if(!env) return -1;
+    for(long long j=0;j<L;j++) env[j] = (float)exp(-(L > 1 ? 6.0*(double)j/(double)(L-1) : 0.0));
+
+    memset(c, 0, (size_t)n*sizeof(float));
+    long long span = (n - L > 1) ? n - L : 1;
+    for(long long k=0;k<expected;k++){
+        long long pos = (long long)(chan_uniform(r) * (double)span);
+        float amp = (float)(2.0*chan_uniform(r) - 1.0);
+        long long e = (pos + L < n) ? L : n - pos;
+        for(long long j=0;j<e;j++) c[pos+j] += amp * env[j];
+    }
+    free(env);
+
+    double cr = chan_rms(c, n);
+    if(cr < 1e-9) return 0;
+    chan_add(x, c, n, (float)(chan_noise_gain(x, n, snr_db) / (cr + 1e-12)));
+    return 0;
+}
+
+/* 0, or -1 out of memory */
+static inline int chan_noise(int noise, float *x, long long n, int fs, double snr_db, chan_rng *r){
+    if(noise == CHAN_AWGN){ chan_awgn(x, n, snr_db, r); return 0; }
+    float *w = (float*)malloc((size_t)(n > 0 ? n : 1)*sizeof(float));
+    if(!w) return -1;
+    int rc = 0;
+    if(noise == CHAN_PINK) chan_pink(x, n, snr_db, r, w);
+    else if(noise == CHAN_HUM) chan_hum(x, n, snr_db, fs, 50.0, 5, r, w);
+    else if(noise == CHAN_CLICKS) rc = chan_clicks(x, n, snr_db, fs, 2.0, 3.0, r, w);
+    else {
+        chan_awgn(x, n, snr_db + 3.0, r);
+        chan_hum(x, n, snr_db + 6.0, fs, 50.0, 3, r, w);
+        rc = chan_clicks(x, n, snr_db + 6.0, fs, 1.0, 2.0, r, w);
+        chan_clamp(x, n);
+    }
+    free(w);
+    return rc;
+}
+
+/* Preset, then noise: x[0..n) at fs into out[0..chan_out_len(n, fs, preset)).
+ * 0, or -1 out of memory */
+static inline int chan_apply(int preset, int noise, double snr_db, uint64_t seed,
+                             const float *x, long long n, int fs, float *out){
+    chan_rng r;
+    chan_rng_seed(&r, seed);
+    if(chan_preset(preset, x, n, fs, out) != 0) return -1;
+    return chan_noise(noise, out, chan_out_len(n, fs, preset), fs, snr_db, &r);
+}
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * cipher.h - AES-256-CTR session shared by sender and receiver
+ *
+ * A session owns one EVP context, keyed on first use. Starting a message
+ * or seeking only loads a new counter block (IV + offset/16), and between
+ * calls the keystream just continues, so a message can be encrypted or
+ * decrypted a piece at a time, in any order of pieces.
+ *
+ * Per-message IV: with FRAME_IV set in the header's CODE byte, the body
+ * starts with an IV block, channel coded and modulated like a packet:
+ *   IV(16) + CRC32(header || IV)
+ * and every later CRC of the frame (body or packets) runs on from
+ * header || IV. Frames without the flag use the fixed legacy IV.
+ */
+#ifndef CIPHER_H
+#define CIPHER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include "crc32.h"
+
+#define FRAME_IV       0x80    /* CODE byte flag, top of the modulation nibble */
+#define CTR_IV_LEN     16
+#define CTR_IV_BLOCK   (CTR_IV_LEN + 4)
+
+/* Demo key (fixed on both ends), and the fixed IV of frames without
+ * FRAME_IV (sender --fixed-iv, older senders) */
+static const unsigned char ctr_key[32] = "01234567890123456789012345678901";
+static const unsigned char ctr_fixed_iv[CTR_IV_LEN] = "0123456789012345";
+
+typedef struct {
+    EVP_CIPHER_CTX *ctx;
+    const unsigned char *key;       /* 32 bytes */
+    unsigned char iv[CTR_IV_LEN];
+    int keyed;
+    uint64_t off;                   /* message byte the keystream is at */
+} ctr_session;
+
+static inline void ctr_init(ctr_session *s, const unsigned char *key){
+    memset(s, 0, sizeof(*s));
+    s->key = key;
+}
+
+static inline void ctr_free(ctr_session *s){
+    EVP_CIPHER_CTX_free(s->ctx);
+    s->ctx = NULL;
+    s->keyed = 0;
+}
+
+/* Position the keystream at byte off of the message. 0, or -1 */
+static inline int ctr_seek(ctr_session *s, uint64_t off){
+    if(!s->ctx && !(s->ctx = EVP_CIPHER_CTX_new())) return -1;
+
+    unsigned char ctr[CTR_IV_LEN];
+    uint64_t blk = off / 16;
+    unsigned carry = 0;
+    for(int i=CTR_IV_LEN-1;i>=0;i--){
+        unsigned v = s->iv[i] + (unsigned)(blk & 0xFFu) + carry;
+        ctr[i] = (unsigned char)v;
+        carry = v >> 8;
+        blk >>= 8;
+    }
+
+    int ok = s->keyed ? EVP_EncryptInit_ex(s->ctx, NULL, NULL, NULL, ctr)
+                      : EVP_EncryptInit_ex(s->ctx, EVP_aes_256_ctr(), NULL, s->key, ctr);
+    s->keyed = (ok == 1);
+    if(!s->keyed) return -1;
+
+    /* inside a block: burn the keystream bytes before off */
+    unsigned char skip[16];
+    int len = 0, k = (int)(off % 16);
+    memset(skip, 0, sizeof(skip));
+    if(k && EVP_EncryptUpdate(s->ctx, skip, &len, skip, k) != 1) return -1;
+    s->off = off;
+    return 0;
+}
+
+/* Start a message under iv, at byte 0 */
+static inline int ctr_start(ctr_session *s, const unsigned char *iv){
+    memcpy(s->iv, iv, CTR_IV_LEN);
+    return ctr_seek(s, 0);
+}
+
+/* out = in ^ keystream for the next n bytes (in == out is fine). 0, or -1 */
+static inline int ctr_xor(ctr_session *s, const unsigned char *in, unsigned char *out, size_t n){
+    int len = 0;
+    if(!s->keyed || n > (size_t)INT32_MAX) return -1;
+    if(EVP_EncryptUpdate(s->ctx, out, &len, in, (int)n) != 1 || (size_t)len != n){
+        s->keyed = 0;
+        return -1;
+    }
+    s->off += n;
+    return 0;
+}
+
+static inline int ctr_random_iv(unsigned char *iv){
+    return (RAND_bytes(iv, CTR_IV_LEN) == 1) ? 0 : -1;
+}
+
+/* IV block after the header; hcrc is the CRC-32 of the 8-byte header */
+static inline void ctr_iv_block(uint32_t hcrc, const unsigned char *iv, uint8_t *out){
+    memcpy(out, iv, CTR_IV_LEN);
+    uint32_t crc = crc32_update(hcrc, iv, CTR_IV_LEN);
+    uint8_t *cb = out + CTR_IV_LEN;
+    cb[0] = (uint8_t)(crc >> 24); cb[1] = (uint8_t)(crc >> 16);
+    cb[2] = (uint8_t)(crc >> 8);  cb[3] = (uint8_t)crc;
+}
+
+/* 0 if a decoded IV block passes its CRC */
+static inline int ctr_iv_check(uint32_t hcrc, const uint8_t *blk){
+    const uint8_t *cb = blk + CTR_IV_LEN;
+    uint32_t stored = ((uint32_t)cb[0]<<24) | ((uint32_t)cb[1]<<16) | ((uint32_t)cb[2]<<8) | (uint32_t)cb[3];
+    return (crc32_update(hcrc, blk, CTR_IV_LEN) == stored) ? 0 : -1;
+}
+
+#endif
@@ -0,0 +1,207 @@
+/*
+ * cover.h - cover audio for the sender: streamed, looped and mixed
+ *
+ * The sender (and bench, to time it) mix the encoder's samples into a
+ * cover a block at a time: the cover is read COVER_BLOCK frames at a
+ * time, in place from its PCM16 mapping (wavmap.h) or with libsndfile,
+ * downmixed, and resampled to PC_SAMPLE_RATE if it has another rate
+ * (resample.h). At its end the reader seeks back to frame 0 and goes on
+ * filling the same block, so looping costs nothing per sample and memory
+ * does not grow with the cover's length.
+ */
+#ifndef COVER_H
+#define COVER_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sndfile.h>
+#include "phonocrypt.h"
+#include "wavmap.h"
+#include "resample.h"
+
+#define COVER_BLOCK     4096         // frames per cover_mix call, at most
+#define STEGO_STRENGTH  0.2f         // BFSK scale when mixing with cover
+#define COVER_GAIN      0.3f         // cover scale when mixing
+#define ADAPT_REF_RMS   0.05f        // --adaptive: mixed-cover RMS that gets STEGO_STRENGTH
+#define ADAPT_MIN       0.1f         // --adaptive: BFSK scale range
+#define ADAPT_MAX       0.35f
+#define COVER_MAX_L     1024         // largest cover resampling ratio numerator
+#define COVER_RELEASE   (1LL << 20)  // mapped cover frames between page releases
+
+/* Output sample clamp, with or without a cover */
+static inline float cover_clamp(float x){
+    if(x>1.f) return 1.f;
+    if(x<-1.f) return -1.f;
+    return x;
+}
+
+typedef struct {
+    wavmap wm;
+    int mapped;
+    SNDFILE *f;
+    int ch, fs;
+    long long frames, pos;   /* source frames, next frame to read */
+    long long released;      /* mapping dropped up to here (mapped) */
+    float *blk;              /* COVER_BLOCK interleaved frames (libsndfile) */
+    float *in;               /* COVER_BLOCK mono frames at the cover rate */
+    int resample;
+    resampler rs;
+    float *q;                /* resampled, not yet mixed: q[qpos..qn) */
+    long long qn, qpos;
+    float strength;          /* BFSK scale at the end of the last block */
+    double s_min, s_max, s_sum;
+    long long blocks;
+} cover_src;
+
+static inline void cover_close(cover_src *c){
+    if(c->mapped) wavmap_close(&c->wm);
+    if(c->f) sf_close(c->f);
+    free((void*)c->rs.h);
+    free(c->blk);
+    free(c->in);
+    free(c->q);
+    memset(c, 0, sizeof(*c));
+}
+
+/* 0, or -1 if the file can't be read or its rate can't be converted */
+static inline int cover_open(cover_src *c, const char *path){
+    memset(c, 0, sizeof(*c));
+    if(wavmap_open(&c->wm, path) == 0){
+        c->mapped = 1;
+        c->ch = c->wm.channels;
+        c->fs = c->wm.samplerate;
+        c->frames = c->wm.frames;
+    } else {
+        SF_INFO info; memset(&info,0,sizeof(info));
+        c->f = sf_open(path, SFM_READ, &info);
+        if(!c->f || info.frames <= 0 || info.channels <= 0 || info.samplerate <= 0){ cover_close(c); return -1; }
+        c->ch = info.channels;
+        c->fs = info.samplerate;
+        c->frames = info.frames;
+        c->blk = (float*)malloc((size_t)COVER_BLOCK*(size_t)c->ch*sizeof(float));
+        if(!c->blk){ cover_close(c); return -1; }
+    }
+
+    c->in = (float*)malloc((size_t)COVER_BLOCK*sizeof(float));
+    if(!c->in){ cover_close(c); return -1; }
+    c->strength = STEGO_STRENGTH;
+    c->s_min = 1e9;
+
+    if(c->fs != PC_SAMPLE_RATE){
+        int a = PC_SAMPLE_RATE, b = c->fs;
+        while(b){ int t = a % b; a = b; b = t; }
+        c->rs.L = PC_SAMPLE_RATE / a;
+        c->rs.M = c->fs / a;
+        if(c->rs.L > COVER_MAX_L){ cover_close(c); return -1; }
+        double fmin = (c->fs < PC_SAMPLE_RATE) ? c->fs : PC_SAMPLE_RATE;
+        c->rs.h = resampler_design(c->rs.L, (double)c->fs, 0.45 * fmin);
+        c->q = (float*)malloc((size_t)COVER_BLOCK*sizeof(float));
+        if(!c->rs.h || !c->q){ cover_close(c); return -1; }
+        c->resample = 1;
+    }
+    return 0;
+}
+
+/* Up to n mono frames at the cover rate into dst, looping; returns frames
+ * (fewer only if the cover can't be read or rewound) */
+static inline long long cover_read(cover_src *c, float *dst, long long n){
+    long long got = 0;
+    while(got < n){
+        if(c->pos >= c->frames){
+            if(c->f && sf_seek(c->f, 0, SEEK_SET) != 0) break;
+            c->pos = 0;
+            c->released = 0;
+        }
+        long long want = n - got;
+        if(want > c->frames - c->pos) want = c->frames - c->pos;
+
+        long long k;
+        if(c->mapped){
+            k = wavmap_read(&c->wm, c->pos, dst + got, want);
+            /* a madvise per block costs more than the mix; a looping
+             * cover never gets this far and keeps its pages */
+            if(c->pos + k - c->released >= COVER_RELEASE){
+                c->released = c->pos + k;
+                wavmap_release(&c->wm, c->released);
+            }
+        } else {
+            k = (long long)sf_readf_float(c->f, c->blk, (sf_count_t)want);
+            for(long long i=0;i<k;i++){
+                float sum = 0.0f;
+                for(int ch=0;ch<c->ch;ch++) sum += c->blk[i*c->ch + ch];
+                dst[got + i] = sum / (float)c->ch;
+            }
+        }
+        if(k <= 0){
+            /* shorter than its header said: loop at what was there */
+            if(c->pos == 0) break;
+            c->frames = c->pos;
+            continue;
+        }
+        c->pos += k;
+        got += k;
+    }
+    return got;
+}
+
+/* n cover samples at PC_SAMPLE_RATE; silence if the cover gives out */
+static inline void cover_fill(cover_src *c, float *out, long long n){
+    long long k = 0;
+    while(k < n){
+        if(!c->resample){
+            long long g = cover_read(c, out + k, n - k);
+            if(g <= 0) break;
+            k += g;
+            continue;
+        }
+        if(c->qpos == c->qn){
+            long long want = resample_fit(&c->rs, COVER_BLOCK);
+            if(want > COVER_BLOCK) want = COVER_BLOCK;
+            long long g = cover_read(c, c->in, want);
+            if(g <= 0) break;
+            c->qn = resample_run(&c->rs, c->in, g, c->q, COVER_BLOCK);
+            c->qpos = 0;
+            continue;
+        }
+        long long t = c->qn - c->qpos;
+        if(t > n - k) t = n - k;
+        memcpy(out + k, c->q + c->qpos, (size_t)t*sizeof(float));
+        c->qpos += t;
+        k += t;
+    }
+    if(k < n) memset(out + k, 0, (size_t)(n - k)*sizeof(float));
+}
+
+/* buf (BFSK) += cover, in place. The BFSK scale is STEGO_STRENGTH, or
+ * with adaptive set follows the block's cover energy within
+ * [ADAPT_MIN, ADAPT_MAX], ramped across the block so it never steps. */
+static inline void cover_mix(cover_src *c, float *cbuf, float *buf, int n, int adaptive){
+    cover_fill(c, cbuf, n);
+
+    float s0 = c->strength, s1 = STEGO_STRENGTH;
+    if(adaptive){
+        double e = 0.0;
+        for(int i=0;i<n;i++) e += (double)cbuf[i]*cbuf[i];
+        double rms = COVER_GAIN * sqrt(e / n);
+        s1 = (float)(STEGO_STRENGTH * rms / ADAPT_REF_RMS);
+        if(s1 < ADAPT_MIN) s1 = ADAPT_MIN;
+        if(s1 > ADAPT_MAX) s1 = ADAPT_MAX;
+    }
+
+    float ds = (s1 - s0) / (float)n;
+    /* cover_clamp spelled as selects, so the loop vectorizes (min/max) */
+    for(int i=0;i<n;i++){
+        float v = COVER_GAIN * cbuf[i] + (s0 + ds * (float)i) * buf[i];
+        v = (v > 1.f) ? 1.f : v;
+        buf[i] = (v < -1.f) ? -1.f : v;
+    }
+
+    c->strength = s1;
+    if(s1 < c->s_min) c->s_min = s1;
+    if(s1 > c->s_max) c->s_max = s1;
+    c->s_sum += s1;
+    c->blocks++;
+}
+
+#endif
@@ -0,0 +1,165 @@
+/*
+ * crc32.h - CRC-32 (IEEE 802.3, as zlib) shared by sender and receiver
+ *
+ *   crc = crc32_update(0, a, na);
+ *   crc = crc32_update(crc, b, nb);    == crc32_compute(a||b)
+ *
+ * Software path: slicing-by-8 over the static tables in crc32_table.h.
+ * Hardware paths, picked by crc32_init() at runtime: PCLMULQDQ folding on
+ * x86 (the CRC32 instruction of SSE4.2 is the Castagnoli polynomial, so it
+ * can't be used here), CRC32 instructions on ARMv8. Without crc32_init()
+ * everything runs in software.
+ */
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "crc32_table.h"
+
+/* Register-level update (c is the inverted running CRC) */
+typedef uint32_t (*crc32_fn)(uint32_t c, const uint8_t *p, size_t n);
+
+static inline uint32_t crc32_sw(uint32_t c, const uint8_t *p, size_t n){
+    const uint32_t (*t)[256] = crc32_table;
+    while(n >= 8){
+        uint32_t lo = c ^ ((uint32_t)p[0] | ((uint32_t)p[1]<<8) | ((uint32_t)p[2]<<16) | ((uint32_t)p[3]<<24));
+        uint32_t hi = (uint32_t)p[4] | ((uint32_t)p[5]<<8) | ((uint32_t)p[6]<<16) | ((uint32_t)p[7]<<24);
+        c = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+          ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        p += 8;
+        n -= 8;
+    }
+    while(n--) c = t[0][(c ^ *p++) & 0xFF] ^ (c >> 8);
+    return c;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CRC32_HAVE_PCLMUL 1
+
+/* Carry-less multiply folding (Gopal et al., "Fast CRC Computation for
+ * Generic Polynomials Using PCLMULQDQ"), bit-reflected constants for
+ * 0x04C11DB7: four 128-bit lanes fold 64 bytes per step, then 128 -> 64
+ * -> 32 bits with a Barrett reduction. Needs n >= 64, n % 16 == 0. */
+__attribute__((target("pclmul,sse4.1")))
+static inline uint32_t crc32_pclmul_blocks(uint32_t c, const uint8_t *p, size_t n){
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+    const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124LL);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+    const __m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    __m128i x1 = _mm_loadu_si128((const __m128i*)(p + 0x00));
+    __m128i x2 = _mm_loadu_si128((const __m128i*)(p + 0x10));
+    __m128i x3 = _mm_loadu_si128((const __m128i*)(p + 0x20));
+    __m128i x4 = _mm_loadu_si128((const __m128i*)(p + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)c));
+    p += 64;
+    n -= 64;
+
+    while(n >= 64){
+        __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(p + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(p + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(p + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(p + 0x30)));
+        p += 64;
+        n -= 64;
+    }
+
+    /* four lanes -> one */
+    __m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4), x5);
+
+    while(n >= 16){
+        x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)p));
+        p += 16;
+        n -= 16;
+    }
+
+    /* 128 -> 64 bits */
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, k5k0, 0x00), x2);
+
+    /* Barrett reduction to 32 bits */
+    x2 = _mm_and_si128(x1, mask);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+    x2 = _mm_and_si128(x2, mask);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static inline uint32_t crc32_hw(uint32_t c, const uint8_t *p, size_t n){
+    if(n >= 64){
+        size_t blk = n & ~(size_t)15;
+        c = crc32_pclmul_blocks(c, p, blk);
+        p += blk;
+        n -= blk;
+    }
+    return crc32_sw(c, p, n);
+}
+#endif
+
+#if defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <arm_acle.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#define CRC32_HAVE_ARMV8 1
+
+__attribute__((target("+crc")))
+static inline uint32_t crc32_hw(uint32_t c, const uint8_t *p, size_t n){
+    while(n >= 8){
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = __crc32d(c, v);
+        p += 8;
+        n -= 8;
+    }
+    while(n--) c = __crc32b(c, *p++);
+    return c;
+}
+#endif
+
+static crc32_fn crc32_impl = crc32_sw;
+
+/* Select the fastest path this CPU supports */
+static inline void crc32_init(void){
+#if defined(CRC32_HAVE_PCLMUL)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1")) crc32_impl = crc32_hw;
+#elif defined(CRC32_HAVE_ARMV8)
+    if(getauxval(AT_HWCAP) & HWCAP_CRC32) crc32_impl = crc32_hw;
+#endif
+}
+
+/* Extend crc (0 for a fresh one) with n more bytes */
+static inline uint32_t crc32_update(uint32_t crc, const void *data, size_t n){
+    return ~crc32_impl(~crc, (const uint8_t*)data, n);
+}
+
+static inline uint32_t crc32_compute(const uint8_t *data, size_t n){
+    return crc32_update(0, data, n);
+}
+
+#endif
@@ -0,0 +1,178 @@
+/*
+ * fec.h - channel coding between framing and modulation
+ *
+ * The frame header (MAGIC + LEN) is always sent with REP repetition, so
+ * sync and MAGIC refine see the same signal for every code. It is MAGIC,
+ * a CODE byte that was the top byte of the original 32-bit LEN (0 in
+ * frames from older senders), and a 24-bit field: the body's symbol rate
+ * in its top 3 bits (modem.h, RATE_SHIFT) over a 21-bit LEN, so messages
+ * are below 2^21 bytes. CODE's low 3 bits name the code used for the rest
+ * of the frame, ciphertext + CRC32; above them sit the packet flag
+ * (packet.h), the modulation (modem.h) and the IV flag (cipher.h):
+ *   FEC_REP   each bit sent REP times (the original format)
+ *   FEC_CONV  rate-1/2 K=7 convolutional code (171,133 octal), zero
+ *             terminated, block-interleaved, one bit window per coded bit;
+ *             decoded with a soft-decision Viterbi
+ * Coded bits are one per byte (0/1); soft inputs are LLR-like floats,
+ * positive meaning 1. fec_encode / fec_decode work in transmit order, so
+ * the modulator only sees a bit stream.
+ */
+#ifndef FEC_H
+#define FEC_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FEC_REP        0
+#define FEC_CONV       1
+
+#define FEC_K          7
+#define FEC_STATES     (1 << (FEC_K - 1))
+#define FEC_G0         0171
+#define FEC_G1         0133
+#define FEC_ILV_COLS   64      /* interleaver row length (coded bits) */
+
+static inline const char *fec_name(int code){
+    switch(code){
+    case FEC_REP:  return "rep";
+    case FEC_CONV: return "conv";
+    default:       return NULL;
+    }
+}
+
+/* Coded bits for nbytes of payload (tail included) */
+static inline size_t fec_conv_bits(size_t nbytes){
+    return 2u * (8u * nbytes + (FEC_K - 1));
+}
+
+static inline int fec_parity(unsigned v){
+    v ^= v >> 4; v ^= v >> 2; v ^= v >> 1;
+    return (int)(v & 1u);
+}
+
+/* in[0..nbytes) MSB first, then K-1 zero bits; out gets fec_conv_bits() */
+static inline void fec_conv_encode(const uint8_t *in, size_t nbytes, uint8_t *out){
+    unsigned sr = 0;
+    size_t nb = 8u * nbytes + (FEC_K - 1), k = 0;
+    for(size_t i=0;i<nb;i++){
+        unsigned b = (i < 8u*nbytes) ? (in[i >> 3] >> (7 - (i & 7))) & 1u : 0u;
+        sr = ((sr << 1) | b) & ((1u << FEC_K) - 1);
+        out[k++] = (uint8_t)fec_parity(sr & FEC_G0);
+        out[k++] = (uint8_t)fec_parity(sr & FEC_G1);
+    }
+}
+
+/* Block interleaver: coded bits are written in rows of FEC_ILV_COLS and
+ * read out by column, so neighbours in the trellis are ~n/FEC_ILV_COLS
+ * windows apart on air. perm[k] = coded index of the k-th sent bit. */
+static inline void fec_ilv_perm(size_t n, uint32_t *perm){
+    size_t k = 0;
+    for(size_t c=0;c<FEC_ILV_COLS;c++)
+        for(size_t i=c;i<n;i+=FEC_ILV_COLS) perm[k++] = (uint32_t)i;
+}
+
+/* Soft Viterbi over llr[0..fec_conv_bits(nbytes)), in coded (deinterleaved)
+ * order; writes nbytes to out. Returns 0, or -1 on OOM. */
+static inline int fec_conv_decode(const float *llr, size_t nbytes, uint8_t *out){
+    size_t steps = 8u * nbytes + (FEC_K - 1);
+    uint64_t *dec = (uint64_t*)malloc(steps * sizeof(uint64_t));
+    if(!dec) return -1;
+
+    /* branch outputs for each 7-bit register value */
+    uint8_t br[1 << FEC_K];
+    for(unsigned s=0;s<(1u << FEC_K);s++)
+        br[s] = (uint8_t)((fec_parity(s & FEC_G0) << 1) | fec_parity(s & FEC_G1));
+
+    float pm[FEC_STATES], nm[FEC_STATES];
+    for(int s=0;s<FEC_STATES;s++) pm[s] = -1e30f;
+    pm[0] = 0.0f;
+
+    for(size_t t=0;t<steps;t++){
+        float l0 = llr[2*t], l1 = llr[2*t + 1];
+        /* metric of branch output o: (+-l0) + (+-l1) */
+        float bm[4] = { -l0 - l1, -l0 + l1, l0 - l1, l0 + l1 };
+        uint64_t d = 0;
+        float best = -1e30f;
+
+        for(int ns=0;ns<FEC_STATES;ns++){
+            /* predecessors differ in the bit shifted out (top of state) */
+            int pa = ns >> 1, pb = pa | (FEC_STATES >> 1);
+            unsigned ra = ((unsigned)pa << 1) | (unsigned)(ns & 1);
+            unsigned rb = ((unsigned)pb << 1) | (unsigned)(ns & 1);
+            float ma = pm[pa] + bm[br[ra]];
+            float mb = pm[pb] + bm[br[rb]];
+            if(mb > ma){ nm[ns] = mb; d |= (uint64_t)1 << ns; }
+            else nm[ns] = ma;
+            if(nm[ns] > best) best = nm[ns];
+        }
+
+        for(int s=0;s<FEC_STATES;s++) pm[s] = nm[s] - best;
+        dec[t] = d;
+    }
+
+    /* terminated: trace back from state 0 */
+    memset(out, 0, nbytes);
+    int s = 0;
+    for(size_t t=steps;t-- > 0;){
+        if(t < 8u*nbytes && (s & 1)) out[t >> 3] |= (uint8_t)(0x80u >> (t & 7));
+        s = (s >> 1) | (int)(((dec[t] >> s) & 1u) ? (FEC_STATES >> 1) : 0);
+    }
+
+    free(dec);
+    return 0;
+}
+
+/* Coded bits on air for nbytes of body */
+static inline size_t fec_coded_bits(int code, int rep, size_t nbytes){
+    return (code == FEC_CONV) ? fec_conv_bits(nbytes) : 8u * nbytes * (size_t)rep;
+}
+
+/* Body bytes -> fec_coded_bits() bits in transmit order. 0, or -1 on OOM */
+static inline int fec_encode(int code, int rep, const uint8_t *in, size_t nbytes, uint8_t *out){
+    if(code != FEC_CONV){
+        for(size_t i=0;i<8u*nbytes;i++)
+            for(int r=0;r<rep;r++) out[i*(size_t)rep + (size_t)r] = (uint8_t)((in[i >> 3] >> (7 - (i & 7))) & 1u);
+        return 0;
+    }
+
+    size_t nc = fec_conv_bits(nbytes);
+    uint8_t *raw = (uint8_t*)malloc(nc);
+    uint32_t *perm = (uint32_t*)malloc(nc * sizeof(uint32_t));
+    if(!raw || !perm){ free(raw); free(perm); return -1; }
+    fec_conv_encode(in, nbytes, raw);
+    fec_ilv_perm(nc, perm);
+    for(size_t k=0;k<nc;k++) out[k] = raw[perm[k]];
+    free(perm);
+    free(raw);
+    return 0;
+}
+
+/* Transmit-order LLRs -> nbytes body bytes. 0, or -1 on OOM */
+static inline int fec_decode(int code, int rep, const float *llr, size_t nbytes, uint8_t *out){
+    if(code != FEC_CONV){
+        /* soft combining: sum the rep copies of each bit */
+        memset(out, 0, nbytes);
+        for(size_t i=0;i<8u*nbytes;i++){
+            float l = 0.0f;
+            for(int r=0;r<rep;r++) l += llr[i*(size_t)rep + (size_t)r];
+            if(l > 0.0f) out[i >> 3] |= (uint8_t)(0x80u >> (i & 7));
+        }
+        return 0;
+    }
+
+    size_t nc = fec_conv_bits(nbytes);
+    float *dl = (float*)malloc(nc * sizeof(float));
+    uint32_t *perm = (uint32_t*)malloc(nc * sizeof(uint32_t));
+    int rc = -1;
+    if(dl && perm){
+        fec_ilv_perm(nc, perm);
+        for(size_t k=0;k<nc;k++) dl[perm[k]] = llr[k];
+        rc = fec_conv_decode(dl, nbytes, out);
+    }
+    free(perm);
+    free(dl);
+    return rc;
+}
+
+#endif
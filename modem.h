@@ -0,0 +1,131 @@
+/*
+ * modem.h - body modulation profiles shared by sender and receiver
+ *
+ * Preamble and frame header are always BFSK on FREQ_0/FREQ_1, so sync does
+ * not depend on the profile. The high nibble of the header's CODE byte
+ * (fec.h) names the profile of the body; 0 is BFSK, which is what older
+ * senders produce. At the header's symbol length their tones sit 200 Hz
+ * (3 cycles per 15 ms symbol) or more apart, so each is on a null of the
+ * others' Hann-windowed spectrum.
+ *   MOD_BFSK  1 bit/symbol, FREQ_0 / FREQ_1
+ *   MOD_4FSK  2 bits/symbol, one of 4 tones, Gray mapped
+ *   MOD_8FSK  3 bits/symbol, one of 8 tones, Gray mapped
+ *   MOD_MC4   4 bits/symbol, 4 parallel BFSK subcarriers (tone 2c+bit)
+ * Coded bits are packed MSB first into symbols; the last symbol is padded
+ * with zeros.
+ *
+ * Body symbol rates: the frame's LEN is below 2^21, so its top 3 bits
+ * (RATE_SHIFT on) name the body's symbol length, the header bit divided
+ * by div; 0 keeps the header's 15 ms, as older senders, whose receivers
+ * reject the others as an invalid LEN. Symbols get shorter, not the tones
+ * closer, so a rate only fits a profile whose tones stay 2 bins (2/T) or
+ * more apart: on a null of each other or below the first Hann sidelobe.
+ *   RATE_15MS   header rate, all profiles
+ *   RATE_10MS   1.5x, all profiles
+ *   RATE_7MS5   2x, RATE_5MS 3x: BFSK and 4FSK
+ *   RATE_3MS75  4x: BFSK only
+ */
+#ifndef MODEM_H
+#define MODEM_H
+
+#include <stddef.h>
+#include <string.h>
+
+#define MOD_BFSK       0
+#define MOD_4FSK       1
+#define MOD_8FSK       2
+#define MOD_MC4        3
+#define MOD_COUNT      4
+#define MOD_MAX_TONES  8
+
+typedef struct {
+    const char *name;
+    int bits;                      /* coded bits per symbol */
+    int carriers;                  /* 1: M-FSK; >1: parallel BFSK pairs */
+    int tones;
+    double freq[MOD_MAX_TONES];    /* Hz */
+} mod_profile;
+
+static const mod_profile mod_profiles[MOD_COUNT] = {
+    { "bfsk", 1, 1, 2, { 1200.0, 2200.0 } },
+    { "4fsk", 2, 1, 4, { 1000.0, 1400.0, 1800.0, 2200.0 } },
+    { "8fsk", 3, 1, 8, { 900.0, 1100.0, 1300.0, 1500.0, 1700.0, 1900.0, 2100.0, 2300.0 } },
+    { "mc4",  4, 4, 8, { 900.0, 1100.0, 1300.0, 1500.0, 1700.0, 1900.0, 2100.0, 2300.0 } },
+};
+
+#define RATE_15MS      0
+#define RATE_10MS      1
+#define RATE_7MS5      2
+#define RATE_5MS       3
+#define RATE_3MS75     4
+#define RATE_COUNT     5
+#define RATE_SHIFT     21      /* LEN bits 21..23 */
+
+typedef struct {
+    const char *name;
+    double div;                    /* header bit / body symbol */
+} rate_profile;
+
+static const rate_profile rate_profiles[RATE_COUNT] = {
+    { "15ms",   1.0 },
+    { "10ms",   1.5 },
+    { "7.5ms",  2.0 },
+    { "5ms",    3.0 },
+    { "3.75ms", 4.0 },
+};
+
+static inline const mod_profile *mod_get(int id){
+    return (id >= 0 && id < MOD_COUNT) ? &mod_profiles[id] : NULL;
+}
+
+static inline int mod_find(const char *name){
+    for(int i=0;i<MOD_COUNT;i++) if(strcmp(mod_profiles[i].name, name) == 0) return i;
+    return -1;
+}
+
+static inline const rate_profile *rate_get(int id){
+    return (id >= 0 && id < RATE_COUNT) ? &rate_profiles[id] : NULL;
+}
+
+static inline int rate_find(const char *name){
+    for(int i=0;i<RATE_COUNT;i++) if(strcmp(rate_profiles[i].name, name) == 0) return i;
+    return -1;
+}
+
+/* Tones of m at least 2 bins apart at rate r, for a bit_seconds header bit */
+static inline int rate_fits(const mod_profile *m, int r, double bit_seconds){
+    const rate_profile *rp = rate_get(r);
+    if(!rp) return 0;
+    double gap = 1e9;
+    for(int i=0;i<m->tones;i++)
+        for(int j=i+1;j<m->tones;j++){
+            double g = m->freq[j] - m->freq[i];
+            if(g < 0) g = -g;
+            if(g < gap) gap = g;
+        }
+    return gap * bit_seconds / rp->div >= 2.0 - 1e-9;
+}
+
+/* Symbols needed for nbits coded bits */
+static inline size_t mod_symbols(const mod_profile *m, size_t nbits){
+    return (nbits + (size_t)m->bits - 1) / (size_t)m->bits;
+}
+
+/* Tones on air for symbol value v (bits MSB first); returns their count */
+static inline int mod_symbol_tones(const mod_profile *m, unsigned v, int *idx){
+    if(m->carriers > 1){
+        for(int c=0;c<m->carriers;c++) idx[c] = 2*c + (int)((v >> (m->carriers - 1 - c)) & 1u);
+        return m->carriers;
+    }
+    idx[0] = (int)(v ^ (v >> 1));
+    return 1;
+}
+
+/* Symbol value carried by M-FSK tone t (inverse Gray) */
+static inline unsigned mod_tone_value(int t){
+    unsigned v = (unsigned)t;
+    for(unsigned s = v >> 1; s; s >>= 1) v ^= s;
+    return v;
+}
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ * packet.h - packetized body (sender --packets / --resend)
+ *
+ * With FRAME_PKT set in the header's CODE byte, LEN is still the length of
+ * the whole ciphertext, but the body is a run of fixed-size packets, each
+ * channel coded (fec.h) and modulated (modem.h) on its own:
+ *   SEQ(2, BE) + PAYLOAD(PKT_PAYLOAD) + CRC32(header || SEQ || PAYLOAD)
+ * Packet seq carries ciphertext bytes [seq*PKT_PAYLOAD, +PKT_PAYLOAD), the
+ * last one zero padded. The top bit of SEQ marks the last packet of the
+ * transmission. A transmission carries all packets or any ascending subset
+ * of them (a resend of the bad ones) under the same header; the CRC covers
+ * the header, so packets only combine with packets of the same format and
+ * length.
+ */
+#ifndef PACKET_H
+#define PACKET_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "crc32.h"
+
+#define FRAME_PKT      0x08    /* CODE byte flag, next to the FEC code */
+#define PKT_PAYLOAD    64      /* ciphertext bytes per packet */
+#define PKT_BYTES      (2 + PKT_PAYLOAD + 4)
+#define PKT_LAST       0x8000u
+#define PKT_MAX        0x8000u /* packets per message (15-bit SEQ) */
+
+static inline size_t pkt_count(size_t clen){
+    return (clen + PKT_PAYLOAD - 1) / PKT_PAYLOAD;
+}
+
+/* Packet seq of cipher[0..clen) into out[PKT_BYTES]; hcrc is the CRC-32
+ * of the 8-byte frame header */
+static inline void pkt_build(uint32_t hcrc, unsigned seq, int last,
+                             const uint8_t *cipher, size_t clen, uint8_t *out){
+    size_t off = (size_t)seq * PKT_PAYLOAD;
+    size_t n = (clen - off < PKT_PAYLOAD) ? clen - off : PKT_PAYLOAD;
+    unsigned s = seq | (last ? PKT_LAST : 0u);
+    out[0] = (uint8_t)(s >> 8);
+    out[1] = (uint8_t)s;
+    memcpy(out + 2, cipher + off, n);
+    memset(out + 2 + n, 0, PKT_PAYLOAD - n);
+
+    uint32_t crc = crc32_update(hcrc, out, 2 + PKT_PAYLOAD);
+    uint8_t *cb = out + 2 + PKT_PAYLOAD;
+    cb[0] = (uint8_t)(crc >> 24); cb[1] = (uint8_t)(crc >> 16);
+    cb[2] = (uint8_t)(crc >> 8);  cb[3] = (uint8_t)crc;
+}
+
+/* SEQ of a decoded packet, or -1 if its CRC fails */
+static inline long pkt_check(uint32_t hcrc, const uint8_t *pkt, int *last){
+    const uint8_t *cb = pkt + 2 + PKT_PAYLOAD;
+    uint32_t stored = ((uint32_t)cb[0]<<24) | ((uint32_t)cb[1]<<16) | ((uint32_t)cb[2]<<8) | (uint32_t)cb[3];
+    if(crc32_update(hcrc, pkt, 2 + PKT_PAYLOAD) != stored) return -1;
+    unsigned s = ((unsigned)pkt[0] << 8) | pkt[1];
+    *last = (s & PKT_LAST) != 0;
+    return (long)(s & ~PKT_LAST);
+}
+
+#endif
@@ -0,0 +1,2952 @@
+/*
+ * phonocrypt.c - libphonocrypt: the encoder and decoder behind the sender
+ * and receiver tools (API in phonocrypt.h)
+ *
+ * Frame on air:
+ *   PREAMBLE (1.5 s of 1010...) + "STEG" + CODE(1) + LEN(3, BE), all BFSK
+ *   on FREQ_0/FREQ_1 with REP=3 repetition, then the body in the code and
+ *   modulation CODE names (fec.h, modem.h) and the symbol rate in LEN's
+ *   top bits (modem.h): the IV block (cipher.h), then ciphertext + CRC32
+ *   as one block, or with FRAME_PKT a run of packets with a CRC each
+ *   (packet.h). CRCs run on from header || IV.
+ *
+ * Encoder: the frame is built and encrypted at start; pull synthesizes it
+ * symbol by symbol from Hann-windowed tone tables, so memory does not
+ * grow with the message's airtime.
+ *
+ * Decoder, from the pushed frames on:
+ * 1) Downmix to mono (split: keep one plane per channel, each decoded
+ *    on its own from here on)
+ * 2) DC remove + normalize
+ * 3) Bandpass (rough) around 700..2600 Hz to reduce speech/music junk
+ *    (2 and 3 run as one stats pass plus one fused filter pass; stream
+ *    mode only band-passes)
+ * 4) Find preamble: alternation envelope -> coarse offset scan (1010...,
+ *    both polarities) on candidate regions -> exhaustive scan as fallback
+ * 5) Locate the preamble/MAGIC boundary on the bit grid, then refine
+ *    around it by searching MAGIC "STEG"
+ * 6) Decode the REP-coded header, combining the REP windows of a bit as
+ *    soft values; the body uses the code and modulation named in the
+ *    header (fec.h, modem.h): per-bit LLRs from BFSK, M-FSK or subcarrier
+ *    bin energies at the body's symbol rate, then REP soft combining or
+ *    soft Viterbi. The preamble's bin energies give the link's SNR, from
+ *    which pc_rate_advise() picks the fastest safe rate (probe)
+ * 7) CRC check then AES-CTR decrypt. A packetized body (packet.h) is
+ *    checked per packet: bad ones are listed for a resend, the rest is
+ *    decrypted in place, and decoding stops early after RX_PKT_ABORT bad
+ *    packets in a row
+ *
+ * Whole mode buffers the input and decodes it at finish. Stream mode
+ * hunts for the preamble in a bounded window that slides over the input,
+ * then runs the frame decoder (a state machine that resumes where the
+ * samples ran out) as they arrive.
+ *
+ * I/Q reference tables are built once per (fs, spb) in a demod context,
+ * so bit detection does no libm calls; the window correlator is picked
+ * per profile (AVX2/FMA or NEON, scalar reference otherwise; fixed-length
+ * variants for the standard 44.1 / 8 kHz windows). The preamble
+ * scan uses a sliding DFT, so its cost is O(samples) rather than
+ * O(offsets * pre_bits * spb).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdarg.h>
+#include <openssl/evp.h>
+#include "fec.h"
+#include "modem.h"
+#include "crc32.h"
+#include "packet.h"
+#include "cipher.h"
+#include "resample.h"
+#include "rxstats.h"
+#include "channel.h"
+#include "phonocrypt.h"
+
+/* ---------- Shared params (sender and receiver) ---------- */
+#define SAMPLE_RATE     PC_SAMPLE_RATE
+#define FREQ_0          1200.0
+#define FREQ_1          2200.0
+#define BIT_DURATION    0.015
+#define PREAMBLE_SECONDS 1.5
+#define REP             3             // repetition coding of the header (and FEC_REP bodies)
+
+#if (REP % 2) == 0
+#error "REP must be odd (majority vote, polarity derived by complement)"
+#endif
+#if PC_MAX_LEN != (1 << RATE_SHIFT) - 1
+#error "PC_MAX_LEN must be the LEN bits below the rate (RATE_SHIFT)"
+#endif
+
+/* ---------- TX params ---------- */
+#define AMPLITUDE       0.87f         // tone table amplitude
+
+/* ---------- RX params ---------- */
+/* Search params */
+#define SEARCH_SECONDS   60.0
+#define SEARCH_STEP_FRAC 6     /* step = spb/6 */
+#define REFINE_STEPS     24    /* refine +-spb with spb/REFINE_STEPS */
+#define FINE_STEPS       32    /* fine timing: spb/FINE_STEPS steps, then 1/FINE_STEPS of a step */
+#define SDFT_RESEED      8192  /* exact re-sum period of the sliding DFT */
+
+/* Coarse-to-fine acquisition */
+#define SYNC_TOPK        4     /* coarse candidates handed to the fine stage */
+#define SYNC_MAX_REGIONS 64
+#define ENV_WIN_FRAC     2     /* envelope window = pre_bits/ENV_WIN_FRAC blocks */
+#define ENV_THRESH       0.8   /* fraction of alternating blocks in a window */
+#define PRE_PROBE        16    /* preamble bits checked before a full score */
+#define PROBE_MIN        0.75
+#define PRE_TAIL         16    /* preamble bits matched ahead of MAGIC */
+#define SCAN_SLICE       8192  /* offsets per sliding-DFT slice in a scan */
+#define SCAN_MIN_RANGE   256   /* offsets per sweep thread, at least */
+#define RX_MAX_THREADS   64
+
+/* Stream mode */
+#define RX_BLOCK         4096  /* frames taken in per front-end block */
+#define RX_HUNT_FACTOR   4     /* hunt window = RX_HUNT_FACTOR * overlap */
+#define RX_TAIL_BITS     1     /* silence windows appended at end of signal */
+
+#define RX_MAX_PROFILES  16    /* distinct (rate, options) per process */
+#define RX_ERR_LEN       512
+#define RX_MAX_SAMPLES   0x7FFFFFFFLL  /* whole mode and split: frames per input */
+
+#define RX_TARGET_RMS    0.25  /* whole mode normalization */
+#define RX_PKT_ABORT     4     /* consecutive bad packets before giving up */
+
+/* Probe */
+#define RX_SNR_MIN       (-20.0) /* preamble SNR estimates are clamped to this range */
+#define RX_SNR_MAX       60.0
+#define RX_RATE_MARGIN   3.0     /* dB above a rate's need before it is advised */
+
+/* Optional decimation (decimate) */
+#define RX_DEC_RATE      11025.0 /* approximate demod rate */
+#define RX_DEC_CUTOFF    0.36    /* resampler cutoff, fraction of output rate */
+
+/* Profile options (part of the profile cache key) */
+#define RXP_DECIMATE     0x01
+#define RXP_HARD         0x02
+#define RXP_SCALAR       0x04
+
+/* Decryption (cipher.h: ctr_key, ctr_fixed_iv for frames without
+ * FRAME_IV) runs in a ctr_session kept per decoder (split: per line
+ * worker) across frames. */
+
+/* Telemetry goes to the rx_stats bound to the calling thread, NULL while
+ * stats are off, so a hook costs one branch; -DRX_NO_STATS removes them */
+#ifdef RX_NO_STATS
+#define t_stats ((rx_stats*)NULL)
+static inline void stats_bind(rx_stats *s){ (void)s; }
+#else
+static _Thread_local rx_stats *t_stats = NULL;
+static inline void stats_bind(rx_stats *s){ t_stats = s; }
+#endif
+#define STAT_ADD(field, v) do{ if(t_stats) t_stats->field += (uint64_t)(v); }while(0)
+
+/* Run the stage clock for stage; returns the stage to go back to */
+static inline int stats_enter(int stage){ return t_stats ? rx_stats_switch(t_stats, stage) : 0; }
+static inline void stats_leave(int prev){ if(t_stats) rx_stats_switch(t_stats, prev); }
+
+/* ---------- Common ---------- */
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+
+static void pc_init_once(void){
+    crc32_init();
+}
+
+const char *pc_strerror(int err){
+    switch(err){
+    case PC_OK:       return "OK";
+    case PC_ENOMEM:   return "Out of memory";
+    case PC_EINVAL:   return "Invalid argument";
+    case PC_ESTATE:   return "Not valid in this state";
+    case PC_ETOOLONG: return "Message too long";
+    case PC_ERANGE:   return "Packet not in the message";
+    case PC_ECRYPTO:  return "Encrypt failed";
+    case PC_ERANDOM:  return "No random IV";
+    }
+    return "Unknown error";
+}
+
+const char *pc_fec_name(int fec){
+    return fec_name(fec);
+}
+
+int pc_fec_find(const char *name){
+    for(int c=0;fec_name(c);c++) if(strcmp(name, fec_name(c)) == 0) return c;
+    return -1;
+}
+
+const char *pc_mod_name(int mod){
+    const mod_profile *m = mod_get(mod);
+    return m ? m->name : NULL;
+}
+
+int pc_mod_find(const char *name){
+    return mod_find(name);
+}
+
+const char *pc_rate_name(int rate){
+    const rate_profile *r = rate_get(rate);
+    return r ? r->name : NULL;
+}
+
+int pc_rate_find(const char *name){
+    return rate_find(name);
+}
+
+int pc_rate_fits(int rate, int mod){
+    const mod_profile *m = mod_get(mod);
+    return m && rate_fits(m, rate, BIT_DURATION);
+}
+
+/* Probe: preamble SNR (one header-bit bin) the body needs at RATE_15MS,
+ * per code and modulation: where 256-byte frames stop failing on the
+ * channel simulator (AWGN; the codec presets cost less than the margin).
+ * Symbols div times shorter have div times less energy per bin, so a
+ * rate needs 10*log10(div) dB more; mc4 splits the power four ways. */
+static const double rate_need_db[2][MOD_COUNT] = {
+    /* bfsk  4fsk  8fsk  mc4 */
+    { 10.5, 12.0, 13.0, 21.0 },   /* rep */
+    {  8.0,  8.0,  8.0, 19.0 },   /* conv */
+};
+
+int pc_rate_advise(double snr_db, int fec, int mod){
+    const mod_profile *m = mod_get(mod);
+    if(!m || (fec != FEC_REP && fec != FEC_CONV) || isnan(snr_db)) return -1;
+    for(int r=RATE_COUNT-1;r>=0;r--)
+        if(rate_fits(m, r, BIT_DURATION)
+           && snr_db >= rate_need_db[fec][mod] + 10.0*log10(rate_get(r)->div) + RX_RATE_MARGIN) return r;
+    return -1;
+}
+
+size_t pc_packet_count(size_t len){
+    return pkt_count(len);
+}
+
+static int pre_bits_of(void){
+    int pre_bits = (int)lround(PREAMBLE_SECONDS / BIT_DURATION);
+    return (pre_bits < 32) ? 32 : pre_bits;
+}
+
+/* Samples of a body symbol on air at rate (RATE_15MS: a header bit) */
+static int body_spb_of(int rate){
+    return (int)lround((double)SAMPLE_RATE * (double)BIT_DURATION / rate_get(rate)->div);
+}
+
+/* ---------- Encoder ---------- */
+/* Hann window to reduce spectral splatter (helps codecs a bit) */
+static float hann(int n, int N){
+    if(N <= 1) return 1.f;
+    return 0.5f - 0.5f*cosf(2.0f*(float)M_PI*(float)n/(float)(N-1));
+}
+
+/* One Hann-windowed symbol per frequency, stored as a quadrature pair so a
+ * symbol starting at oscillator phase ph is sin(ph)*wc[n] + cos(ph)*ws[n].
+ * All oscillators advance every symbol (phase = w*si, as a continuous
+ * tone), tracked in double and wrapped, so no drift on long outputs. */
+typedef struct {
+    int spb, tones;
+    float *wc[MOD_MAX_TONES], *ws[MOD_MAX_TONES];
+    double w[MOD_MAX_TONES];      /* rad/sample */
+    double ph[MOD_MAX_TONES];     /* phase at the next symbol start */
+} tone_bank;
+
+static void tone_bank_free(tone_bank *tb){
+    for(int k=0;k<tb->tones;k++){ free(tb->wc[k]); free(tb->ws[k]); }
+    memset(tb, 0, sizeof(*tb));
+}
+
+static int tone_bank_init(tone_bank *tb, int spb, const mod_profile *m){
+    memset(tb, 0, sizeof(*tb));
+    tb->spb = spb;
+    tb->tones = m->tones;
+    for(int k=0;k<m->tones;k++){
+        tb->wc[k] = (float*)malloc((size_t)spb*sizeof(float));
+        tb->ws[k] = (float*)malloc((size_t)spb*sizeof(float));
+        if(!tb->wc[k] || !tb->ws[k]){ tone_bank_free(tb); return -1; }
+
+        tb->w[k] = 2.0*M_PI*m->freq[k]/(double)SAMPLE_RATE;
+        for(int n=0;n<spb;n++){
+            double a = (double)AMPLITUDE * (double)hann(n, spb);
+            tb->wc[k][n] = (float)(a * cos(tb->w[k]*n));
+            tb->ws[k][n] = (float)(a * sin(tb->w[k]*n));
+        }
+    }
+    return 0;
+}
+
+/* Sections of the frame, in transmit order */
+enum { TX_PREAMBLE, TX_HEADER, TX_BLOCKS, TX_END };
+
+struct pc_encoder {
+    pc_encoder_config cfg;
+    unsigned *resend;            /* own copy of cfg.resend */
+    unsigned char *msg;
+    size_t len, cap;
+    int started;
+
+    /* frame, built at start */
+    unsigned char iv[CTR_IV_LEN];
+    unsigned char *frame;        /* STEG + CODE + LEN + ciphertext + CRC32 */
+    int clen;
+    uint8_t ivblk[CTR_IV_BLOCK];
+    uint32_t hcrc;               /* CRC of header || IV the body CRCs run on from */
+    uint8_t *send;               /* packets: send[seq] = 1 if sent */
+    size_t npkt, last;           /* last: 1 + the last seq sent */
+    long long total;             /* samples of the whole frame */
+
+    /* synthesis */
+    int spb, body_spb, pre_bits;  /* header bit, body symbol */
+    const mod_profile *m;
+    tone_bank tb, body_tb;       /* BFSK for preamble and header, the body's profile */
+    tone_bank *cur;              /* bank of the current section */
+    long long si;                /* samples synthesized so far */
+    int sec;                     /* TX_* of the next symbol */
+    long long k;                 /* preamble / header: symbols done */
+    int blk;                     /* body blocks started */
+    size_t seq;                  /* packets: next seq to look at */
+    uint8_t *coded;              /* coded bits of the current block */
+    size_t nc, cpos;
+    float *sym;                  /* the current symbol, sym_n samples */
+    int sym_n, sym_pos;          /* samples of sym pulled (sym_n: none left) */
+};
+
+void pc_encoder_defaults(pc_encoder_config *cfg){
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->fec = PC_FEC_CONV;
+    cfg->mod = PC_MOD_BFSK;
+}
+
+pc_encoder *pc_encoder_new(const pc_encoder_config *cfg){
+    pthread_once(&g_once, pc_init_once);
+    pc_encoder *e = (pc_encoder*)calloc(1, sizeof(*e));
+    if(!e) return NULL;
+    if(cfg) e->cfg = *cfg;
+    else pc_encoder_defaults(&e->cfg);
+    e->m = mod_get(e->cfg.mod);
+    if(!fec_name(e->cfg.fec) || !e->m || !rate_fits(e->m, e->cfg.rate, BIT_DURATION)
+       || (e->cfg.resend && !e->cfg.packets)){ free(e); return NULL; }
+
+    if(e->cfg.resend){
+        e->resend = (unsigned*)malloc((e->cfg.nresend ? e->cfg.nresend : 1)*sizeof(unsigned));
+        if(!e->resend){ free(e); return NULL; }
+        memcpy(e->resend, e->cfg.resend, e->cfg.nresend*sizeof(unsigned));
+        e->cfg.resend = e->resend;
+    }
+    if(e->cfg.iv){
+        memcpy(e->iv, e->cfg.iv, CTR_IV_LEN);
+        e->cfg.iv = e->iv;
+    }
+
+    e->spb = (int)lround((double)SAMPLE_RATE * (double)BIT_DURATION);
+    e->body_spb = body_spb_of(e->cfg.rate);
+    e->pre_bits = pre_bits_of();
+    e->sym = (float*)malloc((size_t)e->spb*sizeof(float));
+    if(!e->sym || tone_bank_init(&e->tb, e->spb, mod_get(MOD_BFSK)) != 0 || tone_bank_init(&e->body_tb, e->body_spb, e->m) != 0){
+        pc_encoder_free(e);
+        return NULL;
+    }
+    return e;
+}
+
+void pc_encoder_free(pc_encoder *e){
+    if(!e) return;
+    tone_bank_free(&e->tb);
+    tone_bank_free(&e->body_tb);
+    free(e->sym);
+    free(e->coded);
+    free(e->send);
+    free(e->frame);
+    free(e->msg);
+    free(e->resend);
+    free(e);
+}
+
+int pc_encoder_push(pc_encoder *e, const void *msg, size_t len){
+    if(e->started) return PC_ESTATE;
+    if(len > (size_t)PC_MAX_LEN - e->len) return PC_ETOOLONG;
+    if(e->len + len > e->cap){
+        size_t cap = e->cap ? e->cap : 256;
+        while(cap < e->len + len) cap *= 2;
+        unsigned char *m = (unsigned char*)realloc(e->msg, cap);
+        if(!m) return PC_ENOMEM;
+        e->msg = m;
+        e->cap = cap;
+    }
+    memcpy(e->msg + e->len, msg, len);
+    e->len += len;
+    return PC_OK;
+}
+
+/* STEG + CODE + RATE|LEN + ciphertext + CRC32, the message encrypted under
+ * e->iv. Unless fixed_iv, ivblk gets the IV block. hcrc is the CRC of
+ * header || IV that the body CRC and packets run on from. */
+static int enc_build_frame(pc_encoder *e){
+    int clen = e->clen;
+    size_t frame_no_crc = 4 + 4 + (size_t)clen;
+    unsigned char *frame = (unsigned char*)malloc(frame_no_crc + 4);
+    if(!frame) return PC_ENOMEM;
+    e->frame = frame;
+
+    frame[0]='S'; frame[1]='T'; frame[2]='E'; frame[3]='G';
+    frame[4]=(unsigned char)((e->cfg.mod << 4) | e->cfg.fec | (e->cfg.packets ? FRAME_PKT : 0) | (e->cfg.fixed_iv ? 0 : FRAME_IV));
+    frame[5]=(unsigned char)((e->cfg.rate << (RATE_SHIFT - 16)) | (clen>>16)); frame[6]=(clen>>8)&0xFF; frame[7]=(clen)&0xFF;
+
+    /* encrypt in place */
+    ctr_session cs;
+    ctr_init(&cs, ctr_key);
+    int enc = ctr_start(&cs, e->iv) == 0 && ctr_xor(&cs, e->msg, frame + 8, (size_t)clen) == 0;
+    ctr_free(&cs);
+    if(!enc) return PC_ECRYPTO;
+
+    /* CRCs run on from header || IV */
+    e->hcrc = crc32_update(0, frame, 8);
+    if(!e->cfg.fixed_iv){
+        ctr_iv_block(e->hcrc, e->iv, e->ivblk);
+        e->hcrc = crc32_update(e->hcrc, e->iv, CTR_IV_LEN);
+    }
+    uint32_t crc = crc32_update(e->hcrc, frame + 8, (size_t)clen);
+    frame[frame_no_crc+0] = (crc>>24)&0xFF;
+    frame[frame_no_crc+1] = (crc>>16)&0xFF;
+    frame[frame_no_crc+2] = (crc>>8)&0xFF;
+    frame[frame_no_crc+3] = (crc)&0xFF;
+    return PC_OK;
+}
+
+static long long enc_block_samples(const pc_encoder *e, size_t nbytes){
+    return (long long)mod_symbols(e->m, fec_coded_bits(e->cfg.fec, REP, nbytes)) * e->body_spb;
+}
+
+/* Back to the first sample of the frame, oscillators at phase 0 */
+static void enc_rewind(pc_encoder *e){
+    memset(e->tb.ph, 0, sizeof(e->tb.ph));
+    e->cur = &e->tb;
+    e->si = 0;
+    e->sec = TX_PREAMBLE;
+    e->k = 0;
+    e->blk = 0;
+    e->seq = 0;
+    e->nc = e->cpos = 0;
+    e->sym_n = e->sym_pos = 0;
+}
+
+int pc_encoder_start(pc_encoder *e){
+    if(e->started) return PC_ESTATE;
+
+    /* IV: the message's own (random, or cfg.iv for a resend), or the fixed one */
+    if(e->cfg.fixed_iv) memcpy(e->iv, ctr_fixed_iv, CTR_IV_LEN);
+    else if(!e->cfg.iv && ctr_random_iv(e->iv) != 0) return PC_ERANDOM;
+
+    if(e->len > (size_t)PC_MAX_LEN) return PC_ETOOLONG;
+    e->clen = (int)e->len;
+
+    /* packets to send: all, or the resend list */
+    if(e->cfg.packets){
+        e->npkt = pkt_count(e->len);
+        if(e->npkt > PKT_MAX) return PC_ETOOLONG;
+        e->send = (uint8_t*)calloc(e->npkt ? e->npkt : 1, 1);
+        if(!e->send) return PC_ENOMEM;
+        if(!e->cfg.resend) memset(e->send, 1, e->npkt);
+        for(size_t i=0;e->cfg.resend && i<e->cfg.nresend;i++){
+            if(e->cfg.resend[i] >= e->npkt){ free(e->send); e->send = NULL; return PC_ERANGE; }
+            e->send[e->cfg.resend[i]] = 1;
+        }
+        e->last = e->npkt;
+        while(e->last > 0 && !e->send[e->last-1]) e->last--;
+    }
+
+    /* preamble, header, IV block, then one body block or the packets sent */
+    size_t largest = e->cfg.packets ? PKT_BYTES : (size_t)e->clen + 4;
+    if(largest < CTR_IV_BLOCK) largest = CTR_IV_BLOCK;
+
+    int rc = enc_build_frame(e);
+    if(rc == PC_OK && !(e->coded = (uint8_t*)malloc(fec_coded_bits(e->cfg.fec, REP, largest)))) rc = PC_ENOMEM;
+    if(rc != PC_OK){
+        free(e->frame);
+        free(e->send);
+        e->frame = NULL;
+        e->send = NULL;
+        return rc;
+    }
+
+    e->total = ((long long)e->pre_bits + 64LL * REP) * e->spb;
+    if(!e->cfg.fixed_iv) e->total += enc_block_samples(e, CTR_IV_BLOCK);
+    if(!e->cfg.packets) e->total += enc_block_samples(e, (size_t)e->clen + 4);
+    else for(size_t s=0;s<e->npkt;s++) if(e->send[s]) e->total += enc_block_samples(e, PKT_BYTES);
+
+    enc_rewind(e);
+    e->started = 1;
+    return PC_OK;
+}
+
+long long pc_encoder_length(const pc_encoder *e){
+    return e->started ? e->total : 0;
+}
+
+const unsigned char *pc_encoder_iv(const pc_encoder *e){
+    return e->started ? e->iv : NULL;
+}
+
+/* Switch to another bank, with its oscillators at the phase they would
+ * have as continuous tones at the current sample */
+static void enc_use_bank(pc_encoder *e, tone_bank *tb){
+    for(int k=0;k<tb->tones;k++) tb->ph[k] = fmod(tb->w[k]*(double)e->si, 2.0*M_PI);
+    e->cur = tb;
+}
+
+/* one symbol of the bank's spb samples into e->sym: the n tones idx[] at
+ * 1/n amplitude each */
+static void enc_tones(pc_encoder *e, const int *idx, int n){
+    tone_bank *tb = e->cur;
+    float sp[MOD_MAX_TONES], cp[MOD_MAX_TONES];
+    for(int t=0;t<n;t++){
+        sp[t] = (float)(sin(tb->ph[idx[t]]) / n);
+        cp[t] = (float)(cos(tb->ph[idx[t]]) / n);
+    }
+
+    for(int s=0;s<tb->spb;s++){
+        float sig = 0.0f;
+        for(int t=0;t<n;t++) sig += sp[t]*tb->wc[idx[t]][s] + cp[t]*tb->ws[idx[t]][s];
+        e->sym[s] = sig;
+    }
+    e->si += tb->spb;
+    e->sym_n = tb->spb;
+    e->sym_pos = 0;
+
+    for(int k=0;k<tb->tones;k++) tb->ph[k] = fmod(tb->ph[k] + tb->w[k]*tb->spb, 2.0*M_PI);
+}
+
+/* Code the next body block into e->coded: the IV block, then ciphertext +
+ * CRC as one block or one block per packet sent. 1, 0 after the last
+ * block, or PC_ENOMEM */
+static int enc_next_block(pc_encoder *e){
+    const uint8_t *data;
+    size_t nbytes;
+    uint8_t pkt[PKT_BYTES];
+    int has_iv = !e->cfg.fixed_iv;
+
+    if(e->blk == 0 && has_iv){
+        data = e->ivblk;
+        nbytes = CTR_IV_BLOCK;
+    } else if(!e->send){
+        if(e->blk > has_iv) return 0;
+        data = e->frame + 8;
+        nbytes = (size_t)e->clen + 4;
+    } else {
+        while(e->seq < e->npkt && !e->send[e->seq]) e->seq++;
+        if(e->seq >= e->npkt) return 0;
+        pkt_build(e->hcrc, (unsigned)e->seq, e->seq + 1 == e->last, e->frame + 8, (size_t)e->clen, pkt);
+        e->seq++;
+        data = pkt;
+        nbytes = PKT_BYTES;
+    }
+    e->blk++;
+    e->nc = fec_coded_bits(e->cfg.fec, REP, nbytes);
+    e->cpos = 0;
+    return (fec_encode(e->cfg.fec, REP, data, nbytes, e->coded) == 0) ? 1 : PC_ENOMEM;
+}
+
+/* Synthesize the next symbol: preamble 1010..., header bits with
+ * repetition (BFSK), then the body blocks, coded bits packed into symbols
+ * of the profile (modem.h), each block starting on a symbol boundary.
+ * 1, 0 at the end of the frame, or PC_ENOMEM */
+static int enc_next_symbol(pc_encoder *e){
+    for(;;){
+        if(e->sec == TX_PREAMBLE){
+            if(e->k < e->pre_bits){
+                int bit = (int)(e->k++ & 1);
+                enc_tones(e, &bit, 1);
+                return 1;
+            }
+            e->sec = TX_HEADER;
+            e->k = 0;
+        }
+        if(e->sec == TX_HEADER){
+            if(e->k < 64LL * REP){
+                long long b = e->k++ / REP;
+                int bit = (e->frame[b >> 3] >> (7 - (int)(b & 7))) & 1;
+                enc_tones(e, &bit, 1);
+                return 1;
+            }
+            enc_use_bank(e, &e->body_tb);
+            e->sec = TX_BLOCKS;
+        }
+        if(e->sec == TX_BLOCKS){
+            if(e->cpos >= e->nc){
+                int rc = enc_next_block(e);
+                if(rc < 0) return rc;
+                if(rc == 0){ e->sec = TX_END; return 0; }
+            }
+            const mod_profile *m = e->m;
+            unsigned v = 0;
+            for(int b=0;b<m->bits;b++) v = (v << 1) | ((e->cpos + (size_t)b < e->nc) ? e->coded[e->cpos + (size_t)b] : 0u);
+            e->cpos += (size_t)m->bits;
+            int idx[MOD_MAX_TONES];
+            int n = mod_symbol_tones(m, v, idx);
+            enc_tones(e, idx, n);
+            return 1;
+        }
+        return 0;
+    }
+}
+
+long pc_encoder_pull(pc_encoder *e, float *out, long cap){
+    if(!e->started){
+        int rc = pc_encoder_start(e);
+        if(rc != PC_OK) return rc;
+    }
+    long n = 0;
+    while(n < cap){
+        if(e->sym_pos == e->sym_n){
+            int rc = enc_next_symbol(e);
+            if(rc < 0) return rc;
+            if(rc == 0) break;
+        }
+        long k = e->sym_n - e->sym_pos;
+        if(k > cap - n) k = cap - n;
+        memcpy(out + n, e->sym + e->sym_pos, (size_t)k*sizeof(float));
+        e->sym_pos += (int)k;
+        n += k;
+    }
+    return n;
+}
+
+/* ---------- Decoder: front end ---------- */
+/* Simple biquad (RBJ) */
+typedef struct {
+    double b0,b1,b2,a1,a2;
+    double z1,z2;
+} biquad;
+
+static biquad rbj_lowpass(int fs, double f0, double Q){
+    double w0 = 2.0*M_PI*f0/(double)fs;
+    double alpha = sin(w0)/(2.0*Q);
+    double c = cos(w0);
+
+    double b0=(1-c)/2, b1=1-c, b2=(1-c)/2;
+    double a0=1+alpha, a1=-2*c, a2=1-alpha;
+
+    biquad q;
+    q.b0=b0/a0; q.b1=b1/a0; q.b2=b2/a0;
+    q.a1=a1/a0; q.a2=a2/a0;
+    q.z1=0; q.z2=0;
+    return q;
+}
+
+static biquad rbj_highpass(int fs, double f0, double Q){
+    double w0 = 2.0*M_PI*f0/(double)fs;
+    double alpha = sin(w0)/(2.0*Q);
+    double c = cos(w0);
+
+    double b0=(1+c)/2, b1=-(1+c), b2=(1+c)/2;
+    double a0=1+alpha, a1=-2*c, a2=1-alpha;
+
+    biquad q;
+    q.b0=b0/a0; q.b1=b1/a0; q.b2=b2/a0;
+    q.a1=a1/a0; q.a2=a2/a0;
+    q.z1=0; q.z2=0;
+    return q;
+}
+
+/* Bandpass around 700..2600 Hz (helps phone-band BFSK).
+ * Filter state lives in the front end, so blocks can be fed one by one. */
+typedef struct {
+    biquad hp, lp;
+} frontend;
+
+static void frontend_init(frontend *fe, int fs){
+    fe->hp = rbj_highpass(fs, 700.0, 0.707);
+    fe->lp = rbj_lowpass(fs, 2600.0, 0.707);
+}
+
+/* x <- LP(HP(g*(x - dc))) in one pass: both sections run per sample with
+ * their state in registers, so the buffer is read and written once.
+ * Samples are stride apart (one channel of interleaved frames). */
+static void frontend_run(frontend *fe, float *x, int stride, long long n, double dc, double g){
+    const biquad h = fe->hp, l = fe->lp;
+    double hz1=h.z1, hz2=h.z2, lz1=l.z1, lz2=l.z2;
+
+    for(long long i=0;i<n;i++, x+=stride){
+        double in = ((double)*x - dc) * g;
+        double mid = h.b0*in + hz1;
+        hz1 = h.b1*in - h.a1*mid + hz2;
+        hz2 = h.b2*in - h.a2*mid;
+
+        double out = l.b0*mid + lz1;
+        lz1 = l.b1*mid - l.a1*out + lz2;
+        lz2 = l.b2*mid - l.a2*out;
+        *x = (float)out;
+    }
+
+    fe->hp.z1=hz1; fe->hp.z2=hz2;
+    fe->lp.z1=lz1; fe->lp.z2=lz2;
+}
+
+static double biquad_mag2(const biquad *q, double w){
+    double c1=cos(w), s1=sin(w), c2=cos(2*w), s2=sin(2*w);
+    double nr = q->b0 + q->b1*c1 + q->b2*c2, ni = -(q->b1*s1 + q->b2*s2);
+    double dr = 1.0 + q->a1*c1 + q->a2*c2,   di = -(q->a1*s1 + q->a2*s2);
+    return (nr*nr + ni*ni) / (dr*dr + di*di);
+}
+
+/* Power gain of the band-pass at f Hz */
+static double frontend_gain2(const frontend *fe, int fs, double f){
+    double w = 2.0*M_PI*f/(double)fs;
+    return biquad_mag2(&fe->hp, w) * biquad_mag2(&fe->lp, w);
+}
+
+static void frontend_process(frontend *fe, float *x, int n){
+    frontend_run(fe, x, 1, n, 0.0, 1.0);
+}
+
+/* DC offset and the gain to RX_TARGET_RMS from one stats pass (running
+ * sum and sum of squares, RMS about the mean from their difference) */
+static void frontend_stats(const float *x, long long n, double *dc, double *g){
+    double sum=0.0, sq=0.0;
+    for(long long i=0;i<n;i++){
+        double v=x[i];
+        sum += v;
+        sq += v*v;
+    }
+    double mean = sum / (double)n;
+    double var = sq / (double)n - mean*mean;
+    double r = sqrt(var > 0.0 ? var : 0.0);
+
+    *dc = mean;
+    *g = (r < 1e-6) ? 1.0 : RX_TARGET_RMS / r;
+}
+
+/* Whole-signal front end: DC remove, normalize to RX_TARGET_RMS, bandpass.
+ * Offset, gain and both filter sections are applied in a single filter
+ * pass after the stats pass. */
+static void frontend_normalize(frontend *fe, float *x, int n){
+    if(n<=0) return;
+
+    double dc, g;
+    frontend_stats(x, n, &dc, &g);
+    frontend_run(fe, x, 1, n, dc, g);
+}
+
+/* ---------- I/Q correlator ---------- */
+/* One spb window against the four reference tables: iq = {i0, q0, i1, q1}.
+ * iq_ref is the double-precision reference. The SIMD kernels multiply in
+ * float (lane-parallel sums, reduced in double); their decisions match
+ * the reference except for windows whose two bins are within ~1e-6.
+ * A rep_fn gives the bin energies of the REP back-to-back windows of one
+ * coded bit, pw = {p0, p1} per window. */
+typedef struct demod demod;
+typedef void (*iq_fn)(const demod *d, const float *w, double iq[4]);
+typedef void (*rep_fn)(const demod *d, const float *w, double pw[2*REP]);
+
+/* Demodulator context: I/Q reference tables for one bit window at (fs, spb).
+ * Built once so the correlator is a pure multiply-accumulate. */
+struct demod {
+    double fs;
+    int spb;
+    double f0, f1;               /* Hz of bins 0 / 1 */
+    double *c0, *s0, *c1, *s1;
+    float *f;                    /* float tables c0|s0|c1|s1, fstride apart */
+    int fstride;
+    iq_fn iq;
+    rep_fn rep;
+    int hard;                    /* REP majority vote on sliced windows */
+};
+
+static void iq_ref(const demod *d, const float *w, double iq[4]){
+    double i0=0,q0=0,i1=0,q1=0;
+
+    for(int n=0;n<d->spb;n++){
+        double s = w[n];
+
+        i0 += s * d->c0[n];  q0 += s * d->s0[n];
+        i1 += s * d->c1[n];  q1 += s * d->s1[n];
+    }
+
+    iq[0]=i0; iq[1]=q0; iq[2]=i1; iq[3]=q1;
+}
+
+/* Every window's REP copies through iq */
+static void rep_generic(const demod *d, const float *w, double pw[2*REP]){
+    for(int r=0;r<REP;r++){
+        double iq[4];
+        d->iq(d, w + (long long)r*d->spb, iq);
+        pw[2*r] = iq[0]*iq[0]+iq[1]*iq[1];
+        pw[2*r+1] = iq[2]*iq[2]+iq[3]*iq[3];
+    }
+}
+
+/* Scalar tail of the SIMD kernels, samples [n, spb) of the float tables
+ * at c0 (rows fstride apart) */
+static inline void iq_tail(const float *c0, int fstride, const float *w, int n, int spb, double iq[4]){
+    const float *s0 = c0 + fstride, *c1 = s0 + fstride, *s1 = c1 + fstride;
+    for(;n<spb;n++){
+        double s = w[n];
+        iq[0] += s * c0[n];  iq[1] += s * s0[n];
+        iq[2] += s * c1[n];  iq[3] += s * s1[n];
+    }
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define RX_HAVE_AVX2 1
+
+__attribute__((target("avx2,fma")))
+static inline double hsum_avx2(__m256 v){
+    __m256d t = _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(v)),
+                              _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+    __m128d h = _mm_add_pd(_mm256_castpd256_pd128(t), _mm256_extractf128_pd(t, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+}
+
+/* 8 lanes, two accumulator sets per sum to hide FMA latency. Inlined with
+ * spb and fstride as constants for the fixed-length kernels below. */
+__attribute__((target("avx2,fma"), always_inline))
+static inline void iq_avx2_n(const float *c0, int fstride, const float *w, int spb, double iq[4]){
+    const float *s0 = c0 + fstride, *c1 = s0 + fstride, *s1 = c1 + fstride;
+    __m256 a0 = _mm256_setzero_ps(), b0 = a0, a1 = a0, b1 = a0;
+    __m256 e0 = a0, g0 = a0, e1 = a0, g1 = a0;
+    int n = 0;
+
+    for(; n + 16 <= spb; n += 16){
+        __m256 x0 = _mm256_loadu_ps(w + n), x1 = _mm256_loadu_ps(w + n + 8);
+        a0 = _mm256_fmadd_ps(x0, _mm256_load_ps(c0 + n), a0);
+        b0 = _mm256_fmadd_ps(x0, _mm256_load_ps(s0 + n), b0);
+        a1 = _mm256_fmadd_ps(x0, _mm256_load_ps(c1 + n), a1);
+        b1 = _mm256_fmadd_ps(x0, _mm256_load_ps(s1 + n), b1);
+        e0 = _mm256_fmadd_ps(x1, _mm256_load_ps(c0 + n + 8), e0);
+        g0 = _mm256_fmadd_ps(x1, _mm256_load_ps(s0 + n + 8), g0);
+        e1 = _mm256_fmadd_ps(x1, _mm256_load_ps(c1 + n + 8), e1);
+        g1 = _mm256_fmadd_ps(x1, _mm256_load_ps(s1 + n + 8), g1);
+    }
+
+    iq[0] = hsum_avx2(_mm256_add_ps(a0, e0));
+    iq[1] = hsum_avx2(_mm256_add_ps(b0, g0));
+    iq[2] = hsum_avx2(_mm256_add_ps(a1, e1));
+    iq[3] = hsum_avx2(_mm256_add_ps(b1, g1));
+    iq_tail(c0, fstride, w, n, spb, iq);
+}
+
+__attribute__((target("avx2,fma")))
+static void iq_avx2(const demod *d, const float *w, double iq[4]){
+    iq_avx2_n(d->f, d->fstride, w, d->spb, iq);
+}
+
+#if REP == 3
+/* The 3 windows of a coded bit in one pass: every table vector is loaded
+ * once for the three of them (one accumulator set per sum and window) */
+__attribute__((target("avx2,fma"), always_inline))
+static inline void rep3_avx2_n(const float *c0, int fstride, const float *w, int spb, double pw[6]){
+    const float *s0 = c0 + fstride, *c1 = s0 + fstride, *s1 = c1 + fstride;
+    __m256 a0 = _mm256_setzero_ps(), b0 = a0, a1 = a0, b1 = a0;
+    __m256 e0 = a0, g0 = a0, e1 = a0, g1 = a0;
+    __m256 h0 = a0, k0 = a0, h1 = a0, k1 = a0;
+    int n = 0;
+
+    for(; n + 8 <= spb; n += 8){
+        __m256 tc0 = _mm256_load_ps(c0 + n), ts0 = _mm256_load_ps(s0 + n);
+        __m256 tc1 = _mm256_load_ps(c1 + n), ts1 = _mm256_load_ps(s1 + n);
+        __m256 x = _mm256_loadu_ps(w + n);
+        a0 = _mm256_fmadd_ps(x, tc0, a0);  b0 = _mm256_fmadd_ps(x, ts0, b0);
+        a1 = _mm256_fmadd_ps(x, tc1, a1);  b1 = _mm256_fmadd_ps(x, ts1, b1);
+        x = _mm256_loadu_ps(w + spb + n);
+        e0 = _mm256_fmadd_ps(x, tc0, e0);  g0 = _mm256_fmadd_ps(x, ts0, g0);
+        e1 = _mm256_fmadd_ps(x, tc1, e1);  g1 = _mm256_fmadd_ps(x, ts1, g1);
+        x = _mm256_loadu_ps(w + 2*spb + n);
+        h0 = _mm256_fmadd_ps(x, tc0, h0);  k0 = _mm256_fmadd_ps(x, ts0, k0);
+        h1 = _mm256_fmadd_ps(x, tc1, h1);  k1 = _mm256_fmadd_ps(x, ts1, k1);
+    }
+
+    double iq[3][4] = {
+        { hsum_avx2(a0), hsum_avx2(b0), hsum_avx2(a1), hsum_avx2(b1) },
+        { hsum_avx2(e0), hsum_avx2(g0), hsum_avx2(e1), hsum_avx2(g1) },
+        { hsum_avx2(h0), hsum_avx2(k0), hsum_avx2(h1), hsum_avx2(k1) },
+    };
+    for(int r=0;r<3;r++){
+        iq_tail(c0, fstride, w + r*spb, n, spb, iq[r]);
+        pw[2*r] = iq[r][0]*iq[r][0] + iq[r][1]*iq[r][1];
+        pw[2*r+1] = iq[r][2]*iq[r][2] + iq[r][3]*iq[r][3];
+    }
+}
+#endif
+#endif
+
+#if defined(__GNUC__) && defined(__aarch64__)
+#include <arm_neon.h>
+#define RX_HAVE_NEON 1
+
+static double hsum_neon(float32x4_t v){
+    float64x2_t t = vaddq_f64(vcvt_f64_f32(vget_low_f32(v)), vcvt_high_f64_f32(v));
+    return vgetq_lane_f64(t, 0) + vgetq_lane_f64(t, 1);
+}
+
+__attribute__((always_inline))
+static inline void iq_neon_n(const float *c0, int fstride, const float *w, int spb, double iq[4]){
+    const float *s0 = c0 + fstride, *c1 = s0 + fstride, *s1 = c1 + fstride;
+    float32x4_t a0 = vdupq_n_f32(0.0f), b0 = a0, a1 = a0, b1 = a0;
+    int n = 0;
+
+    for(; n + 4 <= spb; n += 4){
+        float32x4_t x = vld1q_f32(w + n);
+        a0 = vfmaq_f32(a0, x, vld1q_f32(c0 + n));
+        b0 = vfmaq_f32(b0, x, vld1q_f32(s0 + n));
+        a1 = vfmaq_f32(a1, x, vld1q_f32(c1 + n));
+        b1 = vfmaq_f32(b1, x, vld1q_f32(s1 + n));
+    }
+
+    iq[0] = hsum_neon(a0); iq[1] = hsum_neon(b0);
+    iq[2] = hsum_neon(a1); iq[3] = hsum_neon(b1);
+    iq_tail(c0, fstride, w, n, spb, iq);
+}
+
+static void iq_neon(const demod *d, const float *w, double iq[4]){
+    iq_neon_n(d->f, d->fstride, w, d->spb, iq);
+}
+
+#if REP == 3
+__attribute__((always_inline))
+static inline void rep3_neon_n(const float *c0, int fstride, const float *w, int spb, double pw[6]){
+    const float *s0 = c0 + fstride, *c1 = s0 + fstride, *s1 = c1 + fstride;
+    float32x4_t a[3][4];
+    for(int r=0;r<3;r++) for(int j=0;j<4;j++) a[r][j] = vdupq_n_f32(0.0f);
+    int n = 0;
+
+    for(; n + 4 <= spb; n += 4){
+        float32x4_t tc0 = vld1q_f32(c0 + n), ts0 = vld1q_f32(s0 + n);
+        float32x4_t tc1 = vld1q_f32(c1 + n), ts1 = vld1q_f32(s1 + n);
+        for(int r=0;r<3;r++){
+            float32x4_t x = vld1q_f32(w + r*spb + n);
+            a[r][0] = vfmaq_f32(a[r][0], x, tc0);  a[r][1] = vfmaq_f32(a[r][1], x, ts0);
+            a[r][2] = vfmaq_f32(a[r][2], x, tc1);  a[r][3] = vfmaq_f32(a[r][3], x, ts1);
+        }
+    }
+
+    for(int r=0;r<3;r++){
+        double iq[4] = { hsum_neon(a[r][0]), hsum_neon(a[r][1]), hsum_neon(a[r][2]), hsum_neon(a[r][3]) };
+        iq_tail(c0, fstride, w + r*spb, n, spb, iq);
+        pw[2*r] = iq[0]*iq[0] + iq[1]*iq[1];
+        pw[2*r+1] = iq[2]*iq[2] + iq[3]*iq[3];
+    }
+}
+#endif
+#endif
+
+/* Best correlator this CPU runs (aarch64 always has NEON); simd 0: the
+ * reference */
+static iq_fn pick_iq(int simd){
+    if(!simd) return iq_ref;
+#if defined(RX_HAVE_AVX2)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return iq_avx2;
+#elif defined(RX_HAVE_NEON)
+    return iq_neon;
+#endif
+    return iq_ref;
+}
+
+/* Fixed-length kernels for the standard profiles, 15 ms bits with REP 3:
+ * 44.1 kHz (662 samples, 166 with --decimate) and 8 kHz (120). The window
+ * length and table stride are compile-time constants, so the loops have
+ * known trip counts and the tails resolve at compile time; the fused REP
+ * kernel reads each table vector once per coded bit instead of once per
+ * window. A demod whose spb matches one gets it when it is built, the
+ * rest (other rates and body symbol lengths, --scalar, -DRX_NO_FIXED)
+ * keep the generic kernels. */
+#define RX_FIXED_SPB(X)  X(662) X(166) X(120)
+#define RX_FSTRIDE(spb)  (((spb) + 7) & ~7)
+
+typedef struct {
+    int spb;
+    iq_fn iq;
+    rep_fn rep;
+} fixed_kernel;
+
+#if !defined(RX_NO_FIXED) && REP == 3 && (defined(RX_HAVE_AVX2) || defined(RX_HAVE_NEON))
+#define RX_HAVE_FIXED 1
+#if defined(RX_HAVE_AVX2)
+#define RX_FIXED_FN(N) \
+    __attribute__((target("avx2,fma"))) \
+    static void iq_fixed_##N(const demod *d, const float *w, double iq[4]){ \
+        iq_avx2_n(d->f, RX_FSTRIDE(N), w, N, iq); \
+    } \
+    __attribute__((target("avx2,fma"))) \
+    static void rep_fixed_##N(const demod *d, const float *w, double pw[2*REP]){ \
+        rep3_avx2_n(d->f, RX_FSTRIDE(N), w, N, pw); \
+    }
+#else
+#define RX_FIXED_FN(N) \
+    static void iq_fixed_##N(const demod *d, const float *w, double iq[4]){ \
+        iq_neon_n(d->f, RX_FSTRIDE(N), w, N, iq); \
+    } \
+    static void rep_fixed_##N(const demod *d, const float *w, double pw[2*REP]){ \
+        rep3_neon_n(d->f, RX_FSTRIDE(N), w, N, pw); \
+    }
+#endif
+RX_FIXED_SPB(RX_FIXED_FN)
+
+#define RX_FIXED_ENTRY(N) { N, iq_fixed_##N, rep_fixed_##N },
+static const fixed_kernel fixed_kernels[] = { RX_FIXED_SPB(RX_FIXED_ENTRY) };
+#endif
+
+/* Kernels of d (spb set): a fixed-length pair on top of the SIMD
+ * correlator when one matches, the generic ones otherwise */
+static void pick_kernels(demod *d, int simd){
+    d->iq = pick_iq(simd);
+    d->rep = rep_generic;
+#if defined(RX_HAVE_FIXED)
+    if(d->iq == iq_ref) return;
+    for(size_t i=0;i<sizeof(fixed_kernels)/sizeof(fixed_kernels[0]);i++)
+        if(fixed_kernels[i].spb == d->spb && RX_FSTRIDE(d->spb) == d->fstride){
+            d->iq = fixed_kernels[i].iq;
+            d->rep = fixed_kernels[i].rep;
+        }
+#endif
+}
+
+static void demod_free(demod *d){
+    free(d->c0); free(d->s0); free(d->c1); free(d->s1);
+    free(d->f);
+    memset(d, 0, sizeof(*d));
+}
+
+/* Tables for the bin pair (f0, f1) with the profile options (RXP_*);
+ * demod_init is the FREQ_0/FREQ_1 pair */
+static int demod_init_pair(demod *d, double fs, int spb, double f0, double f1, int flags){
+    memset(d, 0, sizeof(*d));
+    d->c0 = (double*)malloc((size_t)spb*sizeof(double));
+    d->s0 = (double*)malloc((size_t)spb*sizeof(double));
+    d->c1 = (double*)malloc((size_t)spb*sizeof(double));
+    d->s1 = (double*)malloc((size_t)spb*sizeof(double));
+    /* 32-byte aligned rows for aligned vector loads */
+    d->fstride = (spb + 7) & ~7;
+    d->f = (float*)aligned_alloc(32, (size_t)4*(size_t)d->fstride*sizeof(float));
+    if(!d->c0 || !d->s0 || !d->c1 || !d->s1 || !d->f){ demod_free(d); return -1; }
+
+    double w0=2.0*M_PI*f0/fs;
+    double w1=2.0*M_PI*f1/fs;
+    for(int n=0;n<spb;n++){
+        d->c0[n]=cos(w0*n); d->s0[n]=sin(w0*n);
+        d->c1[n]=cos(w1*n); d->s1[n]=sin(w1*n);
+    }
+    for(int n=0;n<d->fstride;n++){
+        int k = (n < spb);
+        d->f[n]                 = k ? (float)d->c0[n] : 0.0f;
+        d->f[n + d->fstride]    = k ? (float)d->s0[n] : 0.0f;
+        d->f[n + 2*d->fstride]  = k ? (float)d->c1[n] : 0.0f;
+        d->f[n + 3*d->fstride]  = k ? (float)d->s1[n] : 0.0f;
+    }
+    d->fs=fs; d->spb=spb;
+    d->f0=f0; d->f1=f1;
+    pick_kernels(d, !(flags & RXP_SCALAR));
+    d->hard = (flags & RXP_HARD) != 0;
+    return 0;
+}
+
+static int demod_init(demod *d, double fs, int spb, int flags){
+    return demod_init_pair(d, fs, spb, FREQ_0, FREQ_1, flags);
+}
+
+/* demod_init with the tables weighted by the sender's Hann window: a
+ * matched filter */
+static int demod_init_hann(demod *d, double fs, int spb, int flags){
+    if(demod_init(d, fs, spb, flags) != 0) return -1;
+    for(int n=0;n<d->spb;n++){
+        double h = (double)hann(n, d->spb);
+        d->c0[n] *= h; d->s0[n] *= h; d->c1[n] *= h; d->s1[n] *= h;
+        d->f[n] *= (float)h;
+        d->f[n + d->fstride] *= (float)h;
+        d->f[n + 2*d->fstride] *= (float)h;
+        d->f[n + 3*d->fstride] *= (float)h;
+    }
+    return 0;
+}
+
+/* Bin energies of one spb window at f0 / f1 */
+static void bin_power(const demod *d, const float *x, long long start, double *p0, double *p1){
+    STAT_ADD(windows, 1);
+    double iq[4];
+    d->iq(d, x + start, iq);
+
+    *p0=iq[0]*iq[0]+iq[1]*iq[1];
+    *p1=iq[2]*iq[2]+iq[3]*iq[3];
+}
+
+/* I/Q energy compare, phase-robust (one spb window) */
+static int detect_bit_q(const demod *d, const float *x, long long start, int invert){
+    double p0, p1;
+    bin_power(d, x, start, &p0, &p1);
+
+    int bit = (p1 > p0) ? 1 : 0;
+    if(invert) bit ^= 1;
+    return bit;
+}
+
+/* Soft decision of one window: normalized energy difference (p1-p0)/(p1+p0)
+ * in [-1,1]. Positive means bit 1, either polarity derives from the sign. */
+static float soft_of(double p0, double p1){
+    double e = p0 + p1;
+    return (e > 0.0) ? (float)((p1 - p0) / e) : 0.0f;
+}
+
+/* Sliding DFT: soft[m] = soft_of() of the window at m, m in [0,count).
+ * Each bin is a window-relative sum Y(m) = sum x[m+k] e^{jwk}, updated as
+ *   Y(m+1) = e^{-jw} * (Y(m) - x[m] + x[m+spb] e^{jw*spb})
+ * so a position costs O(1) instead of O(spb). Sums are re-seeded exactly
+ * every SDFT_RESEED positions to bound rounding drift.
+ * Needs count + spb - 1 <= number of samples in x. */
+static void sliding_soft(const demod *d, const float *x, long long count, float *soft){
+    int spb = d->spb;
+    double w0=2.0*M_PI*d->f0/d->fs;
+    double w1=2.0*M_PI*d->f1/d->fs;
+    double rc0=cos(w0), rs0=-sin(w0), rc1=cos(w1), rs1=-sin(w1);  /* e^{-jw} */
+    double ec0=cos(w0*spb), es0=sin(w0*spb);                      /* e^{jw*spb} */
+    double ec1=cos(w1*spb), es1=sin(w1*spb);
+
+    STAT_ADD(sdft, count);
+    STAT_ADD(windows, (count + SDFT_RESEED - 1) / SDFT_RESEED);
+
+    double i0=0,q0=0,i1=0,q1=0;
+    for(long long m=0; m<count; m++){
+        if(m % SDFT_RESEED == 0){
+            double iq[4];
+            d->iq(d, x + m, iq);
+            i0=iq[0]; q0=iq[1]; i1=iq[2]; q1=iq[3];
+        }
+
+        soft[m] = soft_of(i0*i0+q0*q0, i1*i1+q1*q1);
+        if(m + 1 >= count) break;
+
+        double out = x[m], in = x[m + spb];
+        double a, b;
+        a = i0 - out + in*ec0;  b = q0 + in*es0;
+        i0 = a*rc0 - b*rs0;     q0 = a*rs0 + b*rc0;
+        a = i1 - out + in*ec1;  b = q1 + in*es1;
+        i1 = a*rc1 - b*rs1;     q1 = a*rs1 + b*rc1;
+    }
+}
+
+/* LLR of one coded bit: the soft values of its REP windows summed, so a
+ * confident window outweighs two marginal ones (positive means 1). With
+ * hard set each window is sliced first and the result is the vote margin. */
+static float decode_coded_llr(const demod *d, const float *x, long long pos, int invert){
+    double pw[2*REP];
+    STAT_ADD(windows, REP);
+    d->rep(d, x + pos, pw);
+
+    float llr=0.0f;
+    for(int r=0;r<REP;r++){
+        float v = d->hard ? ((pw[2*r+1] > pw[2*r]) ? 1.0f : -1.0f) : soft_of(pw[2*r], pw[2*r+1]);
+        llr += invert ? -v : v;
+    }
+    return llr;
+}
+
+/* One byte MSB first; llr (may be NULL) receives the 8 bit LLRs */
+static uint8_t decode_byte_llr(const demod *d, const float *x, long long *pos, int invert, float *llr){
+    uint8_t v=0;
+    for(int k=0;k<8;k++){
+        float l = decode_coded_llr(d, x, *pos, invert);
+        if(llr) llr[k] = l;
+        v = (uint8_t)((v<<1) | (uint8_t)(l > 0.0f));
+        *pos += (long long)REP * (long long)d->spb;
+    }
+    return v;
+}
+
+static uint8_t decode_byte(const demod *d, const float *x, long long *pos, int invert){
+    return decode_byte_llr(d, x, pos, invert, NULL);
+}
+
+/* Score preamble match at offset for both polarities in one pass, from
+ * sliding_soft() values. A window decides 1 iff soft > 0, so the inverted
+ * score is simply the complement. */
+static void score_preamble(const float *soft, long long off, int spb, int pre_bits,
+                           int *score0, int *score1){
+    int score=0;
+    for(int b=0;b<pre_bits;b++){
+        int expected = (b & 1) ? 1 : 0; /* 1010... */
+        int got = soft[off + (long long)b*spb] > 0.0f;
+        if(got == expected) score++;
+    }
+    *score0 = score;
+    *score1 = pre_bits - score;
+}
+
+/* Check for MAGIC "STEG" at p in either polarity. REP is odd, so inverting
+ * every window flips each majority vote and the inverted bytes are ~m.
+ * Returns 1 and sets *inv on a match. */
+static int match_magic(const demod *d, const float *x, long long p, int *inv){
+    static const unsigned char magic[4] = { 'S','T','E','G' };
+    unsigned char m[4];
+    long long tmp = p;
+    for(int i=0;i<4;i++) m[i] = decode_byte(d, x, &tmp, 0);
+
+    for(int inv_try=0; inv_try<=1; inv_try++){
+        unsigned char flip = inv_try ? 0xFF : 0x00;
+        int ok = 1;
+        for(int i=0;i<4;i++) if((unsigned char)(m[i] ^ flip) != magic[i]) ok = 0;
+        if(ok){ *inv = inv_try; return 1; }
+    }
+    return 0;
+}
+
+/* ---------- Sync acquisition (coarse-to-fine) ---------- */
+typedef struct {
+    long long off;   /* preamble start estimate (samples) */
+    int inv;
+    int score;       /* preamble bits matched, out of pre_bits */
+} sync_cand;
+
+/* Stage 1: decimated alternation trace. One decision per spb block at two
+ * block phases (0 and spb/2), so one phase is within spb/4 of the bit grid.
+ * Where ENV_THRESH of a window of blocks alternate, the 1010 preamble is
+ * likely. A passing window may begin a few blocks before the preamble, so
+ * its midpoint (well inside the preamble) is recorded as the region anchor.
+ * Returns the number of anchors written to starts (<= cap), -1 on OOM. */
+static int env_regions(const demod *d, const float *x, long long search_max, int pre_bits,
+                       long long *starts, int cap){
+    int spb = d->spb;
+    int win = pre_bits / ENV_WIN_FRAC;
+    long long nblk = (search_max - spb/2) / spb;
+    if(win < 8 || nblk <= win) return 0;
+
+    uint8_t *alt = (uint8_t*)malloc((size_t)nblk);
+    if(!alt) return -1;
+
+    int cnt = 0;
+    for(int ph=0; ph<2; ph++){
+        long long phase = ph ? spb/2 : 0;
+        int prev = -1;
+        for(long long k=0;k<nblk;k++){
+            double p0, p1;
+            bin_power(d, x, phase + k*spb, &p0, &p1);
+            int b = (p1 > p0) ? 1 : 0;
+            alt[k] = (uint8_t)(prev >= 0 && b != prev);
+            prev = b;
+        }
+
+        int sum = 0, inside = 0;
+        for(long long k=0;k<nblk;k++){
+            sum += alt[k];
+            if(k >= win) sum -= alt[k - win];
+            if(k < win) continue;
+
+            int hit = sum >= (int)(ENV_THRESH * win);
+            if(hit && !inside){
+                long long a = phase + (k - win/2)*spb;
+                int dup = 0;
+                for(int i=0;i<cnt;i++) if(llabs(starts[i] - a) < (long long)win*spb) dup = 1;
+                if(!dup && cnt < cap) starts[cnt++] = a;
+            }
+            inside = hit;
+        }
+    }
+
+    free(alt);
+    STAT_ADD(regions, cnt);
+    return cnt;
+}
+
+/* Stage 2: score offsets [lo,hi) in steps, both polarities in one pass.
+ * With probe > 0, an offset whose first probe bits already miss the 1010
+ * pattern is dropped before the full score. Stops early once the score
+ * passes 0.93*pre_bits, or (parallel sweep) once an offset below the
+ * current one has passed it elsewhere (*stop_at). Soft values are built
+ * SCAN_SLICE offsets at a time, so stopping also skips the DFT work.
+ * Needs hi-1 + pre_bits*spb < samples in x. Returns 0, or -1 on OOM. */
+static int scan_offsets(const demod *d, const float *x, long long lo, long long hi,
+                        long long step, int pre_bits, int probe, sync_cand *best,
+                        atomic_llong *stop_at){
+    int spb = d->spb;
+    int thresh = (int)(0.93 * pre_bits);
+    best->off = -1; best->inv = 0; best->score = -1;
+    if(hi <= lo) return 0;
+
+    long long slice = (long long)SCAN_SLICE * step;
+    if(slice > hi - lo) slice = hi - lo;
+    float *soft = (float*)malloc((size_t)(slice - 1 + (long long)(pre_bits - 1)*spb + 1)*sizeof(float));
+    if(!soft) return -1;
+    long long scored = 0, dropped = 0;
+
+    for(long long slo = lo; slo < hi; slo += slice){
+        long long shi = (slo + slice < hi) ? slo + slice : hi;
+        if(stop_at && slo > atomic_load_explicit(stop_at, memory_order_relaxed)) break;
+
+        long long count = (shi - 1 - slo) + (long long)(pre_bits - 1)*spb + 1;
+        sliding_soft(d, x + slo, count, soft);
+
+        for(long long off=slo; off<shi; off += step){
+            const float *sw = soft + (off - slo);
+            int s0, s1;
+            scored++;
+            if(probe > 0){
+                score_preamble(sw, 0, spb, probe, &s0, &s1);
+                if((s0 > s1 ? s0 : s1) < (int)(PROBE_MIN * probe)){ dropped++; continue; }
+            }
+
+            score_preamble(sw, 0, spb, pre_bits, &s0, &s1);
+            if(s0 > best->score){ best->score=s0; best->off=off; best->inv=0; }
+            if(s1 > best->score){ best->score=s1; best->off=off; best->inv=1; }
+
+            if(best->score > thresh){
+                if(stop_at){
+                    long long cur = atomic_load(stop_at);
+                    while(off < cur && !atomic_compare_exchange_weak(stop_at, &cur, off)) {}
+                }
+                goto out;
+            }
+        }
+    }
+
+out:
+    STAT_ADD(offsets, scored);
+    STAT_ADD(probe_dropped, dropped);
+    free(soft);
+    return 0;
+}
+
+/* ---------- Parallel offset sweep ---------- */
+typedef struct {
+    const demod *d;
+    const float *x;
+    long long lo, hi, step;
+    int pre_bits, probe;
+    atomic_llong *stop_at;
+    rx_stats *st;        /* stats: this range's counters */
+    sync_cand best;
+    int rc;
+} scan_job;
+
+static void *scan_worker(void *arg){
+    scan_job *j = (scan_job*)arg;
+    rx_stats *prev = t_stats;
+    stats_bind(j->st);
+    j->rc = scan_offsets(j->d, j->x, j->lo, j->hi, j->step, j->pre_bits, j->probe, &j->best, j->stop_at);
+    stats_bind(prev);
+    return NULL;
+}
+
+/* scan_offsets over [lo,hi) split into threads contiguous ranges on the
+ * same offset grid, each of SCAN_MIN_RANGE offsets or more (a range also
+ * slides its DFT over the pre_bits windows past its end, so tiny ranges
+ * would redo more than they share). Workers share the lowest offset that
+ * passed the threshold; merging in range order reproduces the sequential
+ * result. */
+static int scan_offsets_par(const demod *d, const float *x, long long lo, long long hi,
+                            long long step, int pre_bits, int probe, int threads, sync_cand *best){
+    long long noff = (hi > lo) ? (hi - lo + step - 1) / step : 0;
+    int nt = threads;
+    if(nt > RX_MAX_THREADS) nt = RX_MAX_THREADS;
+    if(noff < (long long)nt * SCAN_MIN_RANGE) nt = (int)(noff / SCAN_MIN_RANGE);
+    if(nt < 1) nt = 1;
+    if(t_stats && (uint64_t)nt > t_stats->sweep_threads) t_stats->sweep_threads = (uint64_t)nt;
+    if(nt == 1) return scan_offsets(d, x, lo, hi, step, pre_bits, probe, best, NULL);
+
+    atomic_llong stop_at;
+    atomic_init(&stop_at, LLONG_MAX);
+    scan_job jobs[RX_MAX_THREADS];
+    pthread_t tid[RX_MAX_THREADS];
+    rx_stats *parent = t_stats, part[RX_MAX_THREADS];
+    int started = 0;
+
+    for(int t=0;t<nt;t++){
+        scan_job *j = &jobs[t];
+        j->d = d; j->x = x; j->step = step;
+        j->pre_bits = pre_bits; j->probe = probe;
+        j->stop_at = &stop_at;
+        j->st = parent ? &part[t] : NULL;
+        if(parent) memset(&part[t], 0, sizeof(part[t]));
+        j->lo = lo + (noff * t / nt) * step;
+        j->hi = lo + (noff * (t+1) / nt) * step;
+        if(j->hi > hi) j->hi = hi;
+        j->rc = 0;
+        if(pthread_create(&tid[t], NULL, scan_worker, j) != 0) break;
+        started++;
+    }
+    /* ranges whose thread could not start run here */
+    for(int t=started;t<nt;t++) scan_worker(&jobs[t]);
+    for(int t=0;t<started;t++) pthread_join(tid[t], NULL);
+    if(parent) for(int t=0;t<nt;t++) rx_stats_merge(parent, &part[t]);
+
+    int thresh = (int)(0.93 * pre_bits);
+    best->off = -1; best->inv = 0; best->score = -1;
+    for(int t=0;t<nt;t++){
+        if(jobs[t].rc != 0) return -1;
+        if(jobs[t].best.score > best->score) *best = jobs[t].best;
+        if(best->score > thresh) break;
+    }
+    return 0;
+}
+
+/* Stage 3: the 1010 preamble matches itself at every even bit shift, so a
+ * coarse offset only fixes the bit phase. On that bit grid, find where the
+ * last PRE_TAIL preamble bits followed by coded MAGIC match best, then
+ * search +-spb around that boundary for the best-aligned MAGIC.
+ * Returns the frame start (sets *inv_out) or -1. */
+static long long refine_sync(const demod *d, const float *x, long long n, const sync_cand *c,
+                             int pre_bits, int *inv_out){
+    static const unsigned char magic[4] = { 'S','T','E','G' };
+    int spb = d->spb;
+    int magic_bits = 4 * 8 * REP;
+    int plen = PRE_TAIL + magic_bits;
+
+    uint8_t pat[PRE_TAIL + 4*8*REP];
+    for(int i=0;i<PRE_TAIL;i++) pat[i] = (uint8_t)((pre_bits - PRE_TAIL + i) & 1);
+    for(int i=0;i<magic_bits;i++){
+        int bit = i / REP;
+        pat[PRE_TAIL + i] = (uint8_t)((magic[bit >> 3] >> (7 - (bit & 7))) & 1);
+    }
+
+    /* boundary candidates, in bits from c->off */
+    int e_lo = pre_bits / 2, e_hi = pre_bits + pre_bits/2;
+    if(e_lo < PRE_TAIL) e_lo = PRE_TAIL;
+    long long nb = e_hi + magic_bits;
+    if(c->off + nb*spb > n) nb = (n - c->off) / spb;
+    if(nb < e_lo + magic_bits) return -1;
+    STAT_ADD(refine_calls, 1);
+
+    uint8_t *g = (uint8_t*)malloc((size_t)nb);
+    if(!g) return -1;
+    for(long long b=0;b<nb;b++) g[b] = (uint8_t)detect_bit_q(d, x, c->off + b*spb, 0);
+
+    long long best_e = -1;
+    int best_m = -1;
+    for(long long e=e_lo; e<=e_hi && e + magic_bits <= nb; e++){
+        int m = 0;
+        for(int j=0;j<plen;j++) m += (g[e - PRE_TAIL + j] == pat[j]);
+        if(plen - m > m) m = plen - m; /* inverted */
+        if(m > best_m){ best_m = m; best_e = e; }
+    }
+    free(g);
+    if(best_e < 0) return -1;
+
+    long long base = c->off + best_e*spb;
+    long long step2 = spb / REFINE_STEPS;
+    if(step2 < 1) step2 = 1;
+
+    /* MAGIC still decodes up to ~1 window off (REP majority), so among the
+     * matching deltas take the one with the largest soft margin. */
+    long long best_p = -1;
+    double best_margin = 0.0;
+    for(long long delta = -spb; delta <= spb; delta += step2){
+        long long p = base + delta;
+        if(p < 0) continue;
+        if(p + (long long)4 * (long long)REP * (long long)spb * 8LL >= n) continue;
+
+        int inv;
+        STAT_ADD(refine_steps, 1);
+        if(!match_magic(d, x, p, &inv)) continue;
+        STAT_ADD(magic_hits, 1);
+
+        double margin = 0.0;
+        for(int j=0;j<magic_bits;j++){
+            double p0, p1;
+            bin_power(d, x, p + (long long)j*spb, &p0, &p1);
+            float sv = soft_of(p0, p1);
+            margin += (pat[PRE_TAIL + j] ^ inv) ? sv : -sv;
+        }
+        if(best_p < 0 || margin > best_margin){
+            best_p = p; best_margin = margin; *inv_out = inv;
+        }
+    }
+    return best_p;
+}
+
+/* Full acquisition over x[0..n): envelope regions -> coarse scan -> top-k
+ * refine, with an exhaustive sweep of [0,search_max) as fallback. */
+typedef struct {
+    sync_cand c;     /* best coarse candidate (c.off < 0: none) */
+    long long pos;   /* frame start, -1 if MAGIC not found */
+    int invert;
+} sync_result;
+
+/* Coarse stage: envelope regions, each scanned around its start; the
+ * SYNC_TOPK best candidates into cands, best first. Returns their count. */
+static int sync_candidates(const demod *d, const float *x, long long search_max, int pre_bits,
+                           sync_cand *cands){
+    int spb = d->spb;
+    long long step = spb / SEARCH_STEP_FRAC;
+    if(step < 1) step = 1;
+    int ncand = 0;
+
+    long long regions[SYNC_MAX_REGIONS];
+    int nreg = env_regions(d, x, search_max, pre_bits, regions, SYNC_MAX_REGIONS);
+    long long hi_max = search_max - (long long)pre_bits*spb; /* exclusive */
+
+    for(int r=0; r<nreg; r++){
+        long long lo = regions[r] - spb, hi = regions[r] + spb;
+        if(lo < 0) lo = 0;
+        if(hi > hi_max) hi = hi_max;
+
+        sync_cand c;
+        if(scan_offsets(d, x, lo, hi, step, pre_bits, PRE_PROBE, &c, NULL) != 0) break;
+        if(c.off < 0) continue;
+
+        /* keep the SYNC_TOPK best, sorted by score; a full list only takes
+         * a candidate that beats its last one */
+        if(ncand == SYNC_TOPK && cands[SYNC_TOPK-1].score >= c.score) continue;
+        int i = (ncand < SYNC_TOPK) ? ncand++ : SYNC_TOPK - 1;
+        while(i > 0 && cands[i-1].score < c.score){ cands[i] = cands[i-1]; i--; }
+        cands[i] = c;
+    }
+    STAT_ADD(candidates, ncand);
+    return ncand;
+}
+
+static void acquire_sync(const demod *d, const float *x, long long n, long long search_max,
+                         int pre_bits, int threads, sync_result *res){
+    int spb = d->spb;
+    long long step = spb / SEARCH_STEP_FRAC;
+    if(step < 1) step = 1;
+    long long hi_max = search_max - (long long)pre_bits*spb; /* exclusive */
+
+    STAT_ADD(sync_passes, 1);
+    int st = stats_enter(RXS_SEARCH);
+    sync_cand cands[SYNC_TOPK];
+    int ncand = sync_candidates(d, x, search_max, pre_bits, cands);
+
+    res->c.off = -1; res->c.inv = 0; res->c.score = -1;
+    res->pos = -1;
+    res->invert = 0;
+
+    stats_enter(RXS_REFINE);
+    for(int i=0; i<ncand && res->pos < 0; i++){
+        res->c = cands[i];
+        res->pos = refine_sync(d, x, n, &res->c, pre_bits, &res->invert);
+    }
+
+    /* fallback: exhaustive sweep of the whole search window; what is
+     * reported is the candidate refined last */
+    if(res->pos < 0){
+        sync_cand c;
+        STAT_ADD(sweeps, 1);
+        stats_enter(RXS_SWEEP);
+        if(scan_offsets_par(d, x, 0, hi_max, step, pre_bits, 0, threads, &c) == 0 && c.off >= 0){
+            res->c = c;
+            stats_enter(RXS_REFINE);
+            res->pos = refine_sync(d, x, n, &res->c, pre_bits, &res->invert);
+        }
+    }
+    stats_leave(st);
+}
+
+/* Probe: SNR of the preamble that ends at frame start pos, from the bin
+ * energies of its windows (all but the first PRE_PROBE bits, where a cut
+ * start or a codec settling would weigh in). The bin of the tone sent
+ * holds signal + noise, the other one noise alone, so the ratio of their
+ * difference to the latter is the SNR in one header-bit bin. dB, clamped
+ * to [RX_SNR_MIN, RX_SNR_MAX]; NAN if no window is in x[0..n). */
+static double preamble_snr(const demod *d, const float *x, long long n, long long pos, int pre_bits, int invert){
+    double on = 0.0, off = 0.0;
+    for(int k=1;k<=pre_bits - PRE_PROBE;k++){
+        long long at = pos - (long long)k*d->spb;
+        if(at < 0 || at + d->spb > n) break;
+        double p0, p1;
+        bin_power(d, x, at, &p0, &p1);
+        int bit = ((pre_bits - k) & 1) ^ invert;
+        on += bit ? p1 : p0;
+        off += bit ? p0 : p1;
+    }
+    if(on <= 0.0) return NAN;
+
+    double r = (on - off) / (off > 0.0 ? off : 1e-30);
+    double db = (r > 0.0) ? 10.0*log10(r) : RX_SNR_MIN;
+    return (db < RX_SNR_MIN) ? RX_SNR_MIN : (db > RX_SNR_MAX) ? RX_SNR_MAX : db;
+}
+
+/* Fine timing for bodies at a faster rate: refine_sync places the frame
+ * start to a fraction of a header bit, which symbols up to 4 times
+ * shorter do not tolerate. Every bit is a Hann-shaped tone burst, so the
+ * energy its tone leaves in a Hann-weighted window (tw, a matched filter)
+ * peaks where the window sits on the bit; summed over the preamble bits,
+ * less the other tone's, the peak is sharp. Searched over +-spb/4 in
+ * steps of spb/FINE_STEPS, then around the best step; 0 if too little
+ * preamble is in x[0..n). Returns the frame start's offset from pos. */
+static long long fine_timing(const demod *tw, const float *x, long long n, long long pos,
+                             int pre_bits, int invert){
+    int spb = tw->spb, bits = pre_bits - PRE_PROBE;
+    long long span = spb/4, step = (spb / FINE_STEPS > 1) ? spb / FINE_STEPS : 1;
+    while(bits > 0 && pos - span - (long long)bits*spb < 0) bits--;
+    if(bits < PRE_PROBE || pos + span > n) return 0;
+
+    long long best = 0;
+    for(int pass=0;pass<2;pass++){
+        long long c = best;
+        double best_sc = -1e300;
+        for(long long dt=c-span; dt<=c+span; dt+=step){
+            double sc = 0.0;
+            for(int k=1;k<=bits;k++){
+                double p0, p1;
+                bin_power(tw, x, pos + dt - (long long)k*spb, &p0, &p1);
+                sc += (((pre_bits - k) & 1) ^ invert) ? p1 - p0 : p0 - p1;
+            }
+            if(sc > best_sc){ best_sc = sc; best = dt; }
+        }
+        span = step;
+        step = (step / FINE_STEPS > 1) ? step / FINE_STEPS : 1;
+    }
+    return best;
+}
+
+/* ---------- Sample window ---------- */
+/* Window x[0..n) of the mono band-passed signal at the demod rate;
+ * positions are absolute and base is the one of x[0]. Whole mode: x is
+ * the whole signal. Stream mode: the window holds at most cap samples,
+ * blocks are filtered (and decimated) with carried state as they come in,
+ * and consumed samples are dropped from the front.
+ * Both modes end the signal with RX_TAIL_BITS windows of silence, since a
+ * frame that ends the input can put its last window a few samples past it. */
+typedef struct {
+    float *x;
+    long long n, base, cap;
+    frontend fe;
+    resampler *rs;      /* non-NULL: decimate after filtering */
+} rx_src;
+
+/* Input frames the next block may have: at most RX_BLOCK, and no more
+ * than fit the room left (stream mode) */
+static long long src_fit(const rx_src *s){
+    long long room = s->cap - s->n;
+    long long fit = s->rs ? resample_fit(s->rs, room) : room;
+    return (fit < RX_BLOCK) ? fit : RX_BLOCK;
+}
+
+/* Filter (and decimate) k mono frames from mono onto the window, k <= src_fit() */
+static void src_push(rx_src *s, float *mono, long long k){
+    int st = stats_enter(RXS_FRONTEND);
+    frontend_process(&s->fe, mono, (int)k);
+    if(s->rs){
+        stats_enter(RXS_DECIMATE);
+        k = resample_run(s->rs, mono, k, s->x + s->n, s->cap - s->n);
+    } else if(mono != s->x + s->n){
+        memcpy(s->x + s->n, mono, (size_t)k*sizeof(float));
+    }
+    s->n += k;
+    stats_leave(st);
+}
+
+static void src_drop(rx_src *s, long long k){
+    if(k <= 0) return;
+    if(k > s->n) k = s->n;
+    memmove(s->x, s->x + k, (size_t)(s->n - k)*sizeof(float));
+    s->n -= k;
+    s->base += k;
+}
+
+/* x[pos .. pos+need) is in the window */
+static int src_has(const rx_src *s, long long pos, long long need){
+    return pos - s->base + need <= s->n;
+}
+/* ---------- Decode result ---------- */
+/* Outcome of decoding one input. Failure reasons are collected in err, one
+ * line each, instead of being printed; pc_decoder_info() hands them out. */
+typedef struct {
+    int rc;                 /* 0: plaintext recovered */
+    char err[RX_ERR_LEN];
+    sync_result sync;       /* absolute positions at the demod rate */
+    int pre_bits;
+    int code, mod, rate;    /* body format from the header */
+    double snr_db;          /* probe: preamble SNR (NAN: no frame found) */
+    int pkt;                /* packetized body */
+    int has_iv;             /* IV sent in the frame (else the fixed one) */
+    unsigned char iv[CTR_IV_LEN];
+    uint32_t clen;
+    unsigned char *cipher;  /* clen bytes (packets: padded to npkt) */
+    uint8_t *have;          /* packets: have[seq] = passed its CRC */
+    int npkt, ngood;
+    unsigned char *plain;   /* NUL-terminated, plen bytes; partial if rc != 0 */
+    int plen;
+    rx_stats stats;         /* stats: telemetry of this decode */
+} rx_result;
+
+static void rx_err(rx_result *res, const char *fmt, ...){
+    res->rc = 1;
+    size_t used = strlen(res->err);
+    if(used + 2 >= sizeof(res->err)) return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(res->err + used, sizeof(res->err) - used - 1, fmt, ap);
+    va_end(ap);
+    strcat(res->err, "\n");
+}
+
+static void rx_result_free(rx_result *res){
+    free(res->cipher);
+    free(res->have);
+    free(res->plain);
+    res->cipher = res->plain = NULL;
+    res->have = NULL;
+}
+
+/* ---------- Per-rate DSP profile ---------- */
+/* spb/pre_bits, demod tables and band-pass coefficients for one sample
+ * rate and set of options (RXP_*). Built on first use and only read
+ * afterwards, so every decoder (and every worker) shares them. */
+typedef struct {
+    int fs, flags;
+    int spb, pre_bits;      /* spb at the demod rate */
+    double fs_dm;           /* demod rate: fs, or fs*L/M when decimating */
+    demod dm;
+    demod tdm;              /* dm Hann-weighted, for fine timing */
+    frontend fe;            /* coefficients, zero state: copy before use */
+    int decim;
+    resampler rs;           /* decim: coefficients, zero state */
+    /* body profiles (modem.h) per symbol rate: bin pairs (tone 2j, 2j+1)
+     * over symbols of rlen samples, kept fractional so body symbols sit on
+     * that grid from the body start on instead of drifting; and the inverse
+     * band-pass power gain per tone so edge tones are not outvoted */
+    double rlen[RATE_COUNT];
+    demod mdm[RATE_COUNT][MOD_COUNT][MOD_MAX_TONES/2];
+    double tone_eq[MOD_COUNT][MOD_MAX_TONES];
+} rx_profile;
+
+static rx_profile g_profiles[RX_MAX_PROFILES];
+static int g_nprofiles = 0;
+static pthread_mutex_t g_profile_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void free_profile(rx_profile *p){
+    demod_free(&p->dm);
+    demod_free(&p->tdm);
+    for(int r=0;r<RATE_COUNT;r++)
+        for(int m=0;m<MOD_COUNT;m++)
+            for(int j=0;j<MOD_MAX_TONES/2;j++) demod_free(&p->mdm[r][m][j]);
+    free((void*)p->rs.h);
+    p->rs.h = NULL;
+}
+
+/* Band-pass, bin pairs and tone equalization for every body profile at
+ * every rate it fits; needs fs, fs_dm and spb. A body symbol is the
+ * sender's symbol scaled as its header bit is, so at RATE_15MS the BFSK
+ * pair is the header's. */
+static int init_body_demods(rx_profile *p){
+    frontend_init(&p->fe, p->fs);
+    for(int r=0;r<RATE_COUNT;r++){
+        p->rlen[r] = (double)p->spb * body_spb_of(r) / body_spb_of(RATE_15MS);
+        int w = (int)lround(p->rlen[r]);
+        for(int m=0;m<MOD_COUNT;m++){
+            const mod_profile *mp = mod_get(m);
+            if(!rate_fits(mp, r, BIT_DURATION)) continue;
+            for(int j=0;2*j<mp->tones;j++)
+                if(demod_init_pair(&p->mdm[r][m][j], p->fs_dm, w, mp->freq[2*j], mp->freq[2*j+1], p->flags) != 0) return -1;
+        }
+    }
+    for(int m=0;m<MOD_COUNT;m++){
+        const mod_profile *mp = mod_get(m);
+        for(int t=0;t<mp->tones;t++) p->tone_eq[m][t] = 1.0 / frontend_gain2(&p->fe, p->fs, mp->freq[t]);
+    }
+    return 0;
+}
+
+static const rx_profile *get_profile(int fs, int flags, rx_result *res){
+    const rx_profile *found = NULL;
+    pthread_mutex_lock(&g_profile_lock);
+
+    for(int i=0;i<g_nprofiles && !found;i++)
+        if(g_profiles[i].fs == fs && g_profiles[i].flags == flags) found = &g_profiles[i];
+
+    if(!found && g_nprofiles == RX_MAX_PROFILES){
+        rx_err(res, "Too many distinct sample rates");
+    } else if(!found){
+        rx_profile *p = &g_profiles[g_nprofiles];
+        memset(p, 0, sizeof(*p));
+        p->spb = (int)lround((double)fs * (double)BIT_DURATION);
+        p->pre_bits = pre_bits_of();
+        p->fs_dm = (double)fs;
+        p->fs = fs;
+        p->flags = flags;
+
+        /* The decimated rate keeps the sender's bit an integer number of
+         * samples: L/M = spb_dm/spb reduced, so the rate itself may be
+         * fractional (44100 Hz: 662 -> 166 samples, 11058.6 Hz). */
+        if((flags & RXP_DECIMATE) && p->spb >= 40 && fs > 1.5 * RX_DEC_RATE){
+            int spb_dm = (int)lround((double)p->spb * RX_DEC_RATE / (double)fs);
+            int a = spb_dm, b = p->spb;
+            while(b){ int t = a % b; a = b; b = t; }
+            p->rs.L = spb_dm / a;
+            p->rs.M = p->spb / a;
+            p->rs.h = resampler_design(p->rs.L, (double)fs, RX_DEC_CUTOFF * fs * p->rs.L / p->rs.M);
+            p->decim = 1;
+            p->fs_dm = (double)fs * p->rs.L / p->rs.M;
+            p->spb = spb_dm;
+        }
+
+        if(p->spb < 40){
+            rx_err(res, "BIT_DURATION too small or fs weird");
+        } else if((p->decim && !p->rs.h) || demod_init(&p->dm, p->fs_dm, p->spb, flags) != 0
+                  || demod_init_hann(&p->tdm, p->fs_dm, p->spb, flags) != 0 || init_body_demods(p) != 0){
+            rx_err(res, "Out of memory (demod tables)");
+            free_profile(p);
+        } else {
+            found = p;
+            g_nprofiles++;
+        }
+    }
+
+    pthread_mutex_unlock(&g_profile_lock);
+    return found;
+}
+
+/* Demod-rate sample positions -> input sample positions */
+static void sync_to_input(const rx_profile *p, sync_result *r){
+    if(!p->decim) return;
+    double delay = 0.5 * (double)(p->rs.L * RS_TAPS - 1);
+    if(r->c.off >= 0) r->c.off = llround(((double)r->c.off * p->rs.M - delay) / p->rs.L);
+    if(r->pos >= 0) r->pos = llround(((double)r->pos * p->rs.M - delay) / p->rs.L);
+}
+
+static void free_profiles(void){
+    for(int i=0;i<g_nprofiles;i++) free_profile(&g_profiles[i]);
+    g_nprofiles = 0;
+}
+
+/* Coded-bit LLRs of one body symbol at pos (m->bits values, MSB first).
+ * BFSK and subcarrier pairs use the normalized energy difference of their
+ * two bins. M-FSK bit b compares the strongest tone whose value has b set
+ * with the strongest one without it, over the total energy. */
+static void symbol_llr(const rx_profile *p, int rate, int mod, const float *x, long long pos, int invert, float *llr){
+    const mod_profile *m = mod_get(mod);
+    double e[MOD_MAX_TONES], tot = 0.0;
+
+    for(int j=0;2*j<m->tones;j++) bin_power(&p->mdm[rate][mod][j], x, pos, &e[2*j], &e[2*j+1]);
+    for(int t=0;t<m->tones;t++){ e[t] *= p->tone_eq[mod][t]; tot += e[t]; }
+
+    for(int b=0;b<m->bits;b++){
+        float v;
+        if(m->carriers > 1 || m->tones == 2){
+            int c = (m->carriers > 1) ? b : 0;
+            v = soft_of(e[2*c], e[2*c+1]);
+        } else {
+            unsigned mask = 1u << (m->bits - 1 - b);
+            double e1 = 0.0, e0 = 0.0;
+            for(int t=0;t<m->tones;t++){
+                if(mod_tone_value(t) & mask){ if(e[t] > e1) e1 = e[t]; }
+                else if(e[t] > e0) e0 = e[t];
+            }
+            v = (tot > 0.0) ? (float)((e1 - e0) / tot) : 0.0f;
+        }
+        if(p->dm.hard) v = (v > 0.0f) ? 1.0f : -1.0f;
+        llr[b] = invert ? -v : v;
+    }
+}
+
+/* ---------- Frame decoder ---------- */
+/* progressive: plaintext not pulled yet */
+typedef struct {
+    unsigned char *b;
+    size_t n, cap, rd;
+} rx_queue;
+
+static int queue_put(rx_queue *q, const void *p, size_t n){
+    if(q->n + n > q->cap){
+        size_t cap = q->cap ? q->cap : 1024;
+        while(cap < q->n + n) cap *= 2;
+        unsigned char *b = (unsigned char*)realloc(q->b, cap);
+        if(!b) return -1;
+        q->b = b;
+        q->cap = cap;
+    }
+    memcpy(q->b + q->n, p, n);
+    q->n += n;
+    return 0;
+}
+
+/* Resumable decode of one frame from its start: header, IV block, then
+ * one body block or the packets. frame_run() demodulates what the window
+ * holds and returns where the samples run out, so stream mode feeds it
+ * as they arrive and whole mode runs it once over the whole signal. */
+enum { RXF_HEADER, RXF_IV, RXF_BODY, RXF_PACKET, RXF_DONE };
+
+typedef struct {
+    int state;
+    long long pos;          /* absolute position of the next byte / symbol */
+    int invert;
+    unsigned char hdr[8];
+    int nhdr;
+    uint32_t hcrc;          /* CRC of header || IV */
+    long long dt;           /* fine timing: frame start offset (faster rates) */
+    int timed;
+    long long body;         /* body start: symbol i of the body at body + i*rlen */
+    size_t bsym;            /* body symbols demodulated */
+    /* block being demodulated */
+    size_t nbytes, nc, nsym, k;
+    float *llr;             /* room for the largest block */
+    uint8_t ivblk[CTR_IV_BLOCK], pkt[PKT_BYTES];
+    /* packets */
+    int npk, bad_run;       /* blocks decoded, bad ones in a row */
+    long next;              /* progressive: next seq to write */
+    int ok;                 /* something usable was decoded */
+} rx_frame;
+
+static void frame_start(rx_frame *f, long long pos, int invert){
+    memset(f, 0, sizeof(*f));
+    f->state = RXF_HEADER;
+    f->pos = pos;
+    f->invert = invert;
+}
+
+static void frame_free(rx_frame *f){
+    free(f->llr);
+    f->llr = NULL;
+}
+
+static void frame_block(rx_frame *f, const rx_result *res, size_t nbytes){
+    f->nbytes = nbytes;
+    f->nc = fec_coded_bits(res->code, REP, nbytes);
+    f->nsym = mod_symbols(mod_get(res->mod), f->nc);
+    f->k = 0;
+}
+
+/* Body block: LLRs of all coded bits in transmit order as the symbols
+ * arrive, then the channel decoder. 1 when out holds the block, 0 if the
+ * window ran out first, -1 on error (in res) */
+static int frame_body(rx_frame *f, const rx_profile *p, const rx_src *src, uint8_t *out,
+                      int eof, rx_result *res){
+    const mod_profile *m = mod_get(res->mod);
+    double len = p->rlen[res->rate];
+    int w = p->mdm[res->rate][res->mod][0].spb;
+    size_t k0 = f->k;
+    int st = stats_enter(RXS_DEMOD);
+    for(;f->k<f->nsym;f->k++){
+        if(!src_has(src, f->pos, w)){
+            STAT_ADD(symbols, f->k - k0);
+            stats_leave(st);
+            if(!eof) return 0;
+            rx_err(res, "Truncated frame (%zu of %zu symbols)", f->k, f->nsym);
+            return -1;
+        }
+        symbol_llr(p, res->rate, res->mod, src->x, f->pos - src->base, f->invert, f->llr + f->k*(size_t)m->bits);
+        f->pos = f->body + llround((double)++f->bsym * len);
+    }
+    STAT_ADD(symbols, f->nsym - k0);
+    if(t_stats) for(size_t i=0;i<f->nc;i++) rx_stats_margin(t_stats, f->llr[i]);
+
+    stats_enter(RXS_FEC);
+    int rc = fec_decode(res->code, REP, f->llr, f->nbytes, out);
+    stats_leave(st);
+    if(rc != 0){ rx_err(res, "Out of memory (FEC)"); return -1; }
+    return 1;
+}
+
+/* progressive: packets [*next, seq) as '?' (lost), then packet seq
+ * decrypted straight from its payload; seq == npkt just fills the gap at
+ * the end. The keystream is only re-seeked after a gap. */
+static int emit_packet(ctr_session *cph, rx_queue *q, const rx_result *res, long *next, long seq, const uint8_t *payload){
+    unsigned char pt[PKT_PAYLOAD];
+    for(;*next<seq;(*next)++){
+        size_t n = res->clen - (size_t)*next*PKT_PAYLOAD;
+        memset(pt, '?', sizeof(pt));
+        if(queue_put(q, pt, n < PKT_PAYLOAD ? n : PKT_PAYLOAD) != 0) return -1;
+    }
+    if(seq < res->npkt){
+        size_t n = res->clen - (size_t)seq*PKT_PAYLOAD;
+        uint64_t off = (uint64_t)seq * PKT_PAYLOAD;
+        if(n > PKT_PAYLOAD) n = PKT_PAYLOAD;
+        int st = stats_enter(RXS_DECRYPT);
+        int rc = (cph->off != off && ctr_seek(cph, off) != 0) || ctr_xor(cph, payload, pt, n) != 0;
+        stats_leave(st);
+        if(rc || queue_put(q, pt, n) != 0) return -1;
+        *next = seq + 1;
+    }
+    return 0;
+}
+
+/* Header decoded: check MAGIC, take the body format, size the LLR buffer */
+static int frame_header(rx_frame *f, rx_result *res){
+    const unsigned char *hdr = f->hdr;
+    if(!(hdr[0]=='S' && hdr[1]=='T' && hdr[2]=='E' && hdr[3]=='G')){
+        rx_err(res, "MAGIC mismatch (should not happen after refine)");
+        rx_err(res, "Got: %02X %02X %02X %02X", hdr[0],hdr[1],hdr[2],hdr[3]);
+        return -1;
+    }
+
+    /* header is hashed now, the body as soon as it is decoded */
+    f->hcrc = crc32_update(0, hdr, 8);
+
+    /* CODE: channel code (fec.h), packet flag (packet.h), modulation
+     * (modem.h) and IV flag (cipher.h) of the body; top bits of LEN: its
+     * symbol rate (modem.h) */
+    int code = hdr[4] & 0x07, mod = (hdr[4] >> 4) & 0x07, rate = hdr[5] >> (RATE_SHIFT - 16);
+    uint32_t clen = ((((uint32_t)hdr[5]<<16) | ((uint32_t)hdr[6]<<8) | (uint32_t)hdr[7])) & (uint32_t)PC_MAX_LEN;
+    if(!fec_name(code) || !mod_get(mod)){
+        rx_err(res, "Unknown body format: code %d, modulation %d", code, mod);
+        return -1;
+    }
+    if(!rate_fits(mod_get(mod), rate, BIT_DURATION)){
+        rx_err(res, "Unknown body format: rate %d, modulation %s", rate, mod_get(mod)->name);
+        return -1;
+    }
+    res->code = code;
+    res->mod = mod;
+    res->rate = rate;
+    f->body = f->pos += (rate != RATE_15MS) ? f->dt : 0;
+    f->bsym = 0;
+    res->pkt = (hdr[4] & FRAME_PKT) != 0;
+    if(clen == 0){
+        rx_err(res, "Invalid LEN: %u", clen);
+        return -1;
+    }
+    res->clen = clen;
+    memcpy(res->iv, ctr_fixed_iv, CTR_IV_LEN);
+    res->has_iv = (hdr[4] & FRAME_IV) != 0;
+
+    size_t largest = res->pkt ? PKT_BYTES : (size_t)clen + 4;
+    if(largest < CTR_IV_BLOCK) largest = CTR_IV_BLOCK;
+    const mod_profile *m = mod_get(mod);
+    f->llr = (float*)malloc(mod_symbols(m, fec_coded_bits(code, REP, largest)) * (size_t)m->bits * sizeof(float));
+    if(!f->llr){ rx_err(res, "Out of memory (LLRs)"); return -1; }
+    return 0;
+}
+
+/* IV done (or not sent): set up the ciphertext block or the packets */
+static int frame_payload(rx_frame *f, ctr_session *cph, rx_queue *q, rx_result *res){
+    if(res->pkt){
+        res->npkt = (int)pkt_count(res->clen);
+        res->cipher = q ? NULL : (unsigned char*)calloc((size_t)res->npkt, PKT_PAYLOAD);
+        res->have = (uint8_t*)calloc((size_t)res->npkt, 1);
+        if((!q && !res->cipher) || !res->have){ rx_err(res, "Out of memory (packets)"); return -1; }
+        if(q && ctr_start(cph, res->iv) != 0){ rx_err(res, "Decrypt failed"); return -1; }
+        f->state = RXF_PACKET;
+        frame_block(f, res, PKT_BYTES);
+        return 0;
+    }
+    res->cipher = (unsigned char*)malloc((size_t)res->clen + 4);
+    if(!res->cipher){ rx_err(res, "Out of memory (frame)"); return -1; }
+    f->state = RXF_BODY;
+    frame_block(f, res, (size_t)res->clen + 4);
+    return 0;
+}
+
+/* One decoded packet: into res->cipher, or with q decrypted and queued.
+ * 1 once the packet flagged last is in, -1 to stop */
+static int frame_packet(rx_frame *f, ctr_session *cph, rx_queue *q, rx_result *res){
+    int last = 0;
+    long seq = pkt_check(f->hcrc, f->pkt, &last);
+    if(seq < 0 || seq >= res->npkt){
+        if(++f->bad_run >= RX_PKT_ABORT){
+            rx_err(res, "Gave up after %d bad packets in a row", f->bad_run);
+            return -1;
+        }
+        return 0;
+    }
+    f->bad_run = 0;
+    if(!res->have[seq] && (!q || seq >= f->next)){
+        if(!q) memcpy(res->cipher + (size_t)seq*PKT_PAYLOAD, f->pkt + 2, PKT_PAYLOAD);
+        else if(emit_packet(cph, q, res, &f->next, seq, f->pkt + 2) != 0){ rx_err(res, "Decrypt failed"); return -1; }
+        res->have[seq] = 1;
+        res->ngood++;
+    }
+    return last;
+}
+
+/* Decode from f->pos on as far as src reaches: MAGIC+LEN, then the body.
+ * The ciphertext goes to res->cipher, packets that pass their CRC are
+ * marked in res->have (with q: decrypted into q instead). With eof set
+ * src is all there is. Returns 1 once the frame is done (f->ok: something
+ * usable was decoded), 0 for more samples. Bad packets only cost their
+ * own bytes; decoding stops at the end of the signal or after
+ * RX_PKT_ABORT bad packets in a row. */
+static int frame_run(rx_frame *f, const rx_profile *p, const rx_src *src, ctr_session *cph,
+                     rx_queue *q, int eof, rx_result *res){
+    const demod *d = &p->dm;
+    long long byte_span = 8LL * REP * d->spb;
+    int rc;
+
+    if(f->state == RXF_HEADER){
+        int st = stats_enter(RXS_DEMOD);
+        if(!f->timed){
+            /* while the preamble is still in the window */
+            f->dt = fine_timing(&p->tdm, src->x, src->n, f->pos - src->base, p->pre_bits, f->invert);
+            f->timed = 1;
+        }
+        for(;f->nhdr<8;f->nhdr++){
+            float llr[8];
+            if(!src_has(src, f->pos, byte_span)){
+                stats_leave(st);
+                if(!eof) return 0;
+                rx_err(res, "Truncated frame (header)");
+                goto fail;
+            }
+            long long at = f->pos - src->base;
+            f->hdr[f->nhdr] = decode_byte_llr(d, src->x, &at, f->invert, llr);
+            f->pos += byte_span;
+            if(t_stats) for(int k=0;k<8;k++) rx_stats_margin(t_stats, llr[k] / REP);
+        }
+        stats_leave(st);
+        if(frame_header(f, res) != 0) goto fail;
+
+        /* per-message IV: its own coded block, CRCs run on from header || IV */
+        if(res->has_iv){
+            f->state = RXF_IV;
+            frame_block(f, res, CTR_IV_BLOCK);
+        }
+        else if(frame_payload(f, cph, q, res) != 0) goto fail;
+    }
+
+    if(f->state == RXF_IV){
+        if((rc = frame_body(f, p, src, f->ivblk, eof, res)) <= 0){ if(rc == 0) return 0; goto fail; }
+        if(ctr_iv_check(f->hcrc, f->ivblk) != 0){ rx_err(res, "IV block CRC mismatch"); goto fail; }
+        memcpy(res->iv, f->ivblk, CTR_IV_LEN);
+        f->hcrc = crc32_update(f->hcrc, res->iv, CTR_IV_LEN);
+        if(frame_payload(f, cph, q, res) != 0) goto fail;
+    }
+
+    if(f->state == RXF_BODY){
+        if((rc = frame_body(f, p, src, res->cipher, eof, res)) <= 0){ if(rc == 0) return 0; goto fail; }
+
+        uint32_t clen = res->clen;
+        const unsigned char *cb = res->cipher + clen;
+        uint32_t crc_stored = ((uint32_t)cb[0]<<24) | ((uint32_t)cb[1]<<16) | ((uint32_t)cb[2]<<8) | (uint32_t)cb[3];
+        uint32_t crc_calc = crc32_update(f->hcrc, res->cipher, clen);
+
+        if(crc_calc != crc_stored){
+            rx_err(res, "CRC mismatch (data corrupted)");
+            rx_err(res, "calc=%08X stored=%08X", crc_calc, crc_stored);
+            goto fail;
+        }
+        f->ok = 1;
+    }
+
+    if(f->state == RXF_PACKET){
+        while(f->npk < res->npkt){
+            if((rc = frame_body(f, p, src, f->pkt, eof, res)) == 0) return 0;
+            if(rc < 0) break;
+            f->npk++;
+            if((rc = frame_packet(f, cph, q, res)) != 0) break;
+            frame_block(f, res, PKT_BYTES);
+        }
+        if(q && f->next > 0 && emit_packet(cph, q, res, &f->next, res->npkt, NULL) != 0) rx_err(res, "Decrypt failed");
+        f->ok = res->ngood > 0;
+    }
+
+    f->state = RXF_DONE;
+    frame_free(f);
+    return 1;
+
+fail:
+    f->ok = 0;
+    f->state = RXF_DONE;
+    frame_free(f);
+    return 1;
+}
+
+/* Report the packets that did not arrive */
+static void rx_missing(rx_result *res){
+    char list[RX_ERR_LEN / 2], ivs[2*CTR_IV_LEN + 8] = "";
+    size_t used = 0;
+    list[0] = 0;
+    for(int k=0;k<res->npkt;k++)
+        if(!res->have[k] && used + 12 < sizeof(list))
+            used += (size_t)snprintf(list + used, sizeof(list) - used, "%s%d", used ? "," : "", k);
+    if(res->has_iv){
+        strcpy(ivs, " --iv ");
+        for(int i=0;i<CTR_IV_LEN;i++) sprintf(ivs + 6 + 2*i, "%02x", res->iv[i]);
+    }
+    else strcpy(ivs, " --fixed-iv");
+    rx_err(res, "Missing %d of %d packets (sender --resend %s%s)", res->npkt - res->ngood, res->npkt, list, ivs);
+}
+
+/* res->cipher -> res->plain. With packets missing the plaintext is kept as
+ * a partial result: missing bytes read '?' and rc stays 1. */
+static void rx_decrypt(ctr_session *cph, rx_result *res){
+    free(res->plain);
+    res->plain = (unsigned char*)malloc((size_t)res->clen + 64);
+    if(!res->plain){ rx_err(res, "Out of memory (plaintext)"); return; }
+
+    int plen = (int)res->clen;
+    int st = stats_enter(RXS_DECRYPT);
+    int rc = ctr_start(cph, res->iv) != 0 || ctr_xor(cph, res->cipher, res->plain, res->clen) != 0;
+    stats_leave(st);
+    if(rc){
+        rx_err(res, "Decrypt failed");
+        free(res->plain);
+        res->plain = NULL;
+        return;
+    }
+    res->plain[plen] = 0;
+    res->plen = plen;
+
+    if(res->pkt && res->ngood < res->npkt){
+        for(int k=0;k<res->npkt;k++){
+            if(res->have[k]) continue;
+            for(size_t i=(size_t)k*PKT_PAYLOAD;i<(size_t)(k+1)*PKT_PAYLOAD && i<(size_t)plen;i++) res->plain[i] = '?';
+        }
+        rx_missing(res);
+        return;
+    }
+    res->rc = 0;
+}
+
+static void rx_result_reset(rx_result *res){
+    memset(res, 0, sizeof(*res));
+    res->sync.c.off = -1; res->sync.c.score = -1; res->sync.pos = -1;
+    res->snr_db = NAN;
+}
+
+static void sync_fail(rx_result *res){
+    const sync_result *r = &res->sync;
+    if(r->c.off < 0) rx_err(res, "Sync not found");
+    else rx_err(res, "MAGIC not found near sync. score=%d/%d", r->c.score, res->pre_bits);
+}
+
+/* Frame done: report a failed one, else decrypt res->cipher into
+ * res->plain (with q a single-block plaintext is queued as well; packets
+ * are already in q) */
+static void frame_end(const rx_frame *f, ctr_session *cph, rx_queue *q, rx_result *res){
+    const sync_result *r = &res->sync;
+
+    if(!f->ok){
+        rx_err(res, "Sync: off=%lld inv=%d score=%d/%d", r->c.off, r->c.inv, r->c.score, res->pre_bits);
+        free(res->cipher);
+        free(res->have);
+        res->cipher = NULL;
+        res->have = NULL;
+        return;
+    }
+    if(!res->cipher){
+        /* progressive: the plaintext is already queued */
+        if(res->ngood < res->npkt) rx_missing(res);
+        else res->rc = 0;
+        return;
+    }
+    rx_decrypt(cph, res);
+    if(q && res->plain && !res->pkt && queue_put(q, res->plain, (size_t)res->plen) != 0)
+        rx_err(res, "Out of memory (plaintext)");
+}
+
+/* Given res->sync, decode the frame in src (the whole signal) */
+static void finish_frame(const rx_profile *p, const rx_src *src, ctr_session *cph, rx_queue *q, rx_result *res){
+    if(res->sync.pos < 0){ sync_fail(res); return; }
+
+    rx_frame f;
+    frame_start(&f, res->sync.pos, res->sync.invert);
+    frame_run(&f, p, src, cph, q, 1, res);
+    frame_end(&f, cph, q, res);
+}
+
+/* Packets of a later transmission of the same message (a resend) fill the
+ * gaps of acc; the result is decrypted again. -1 if more is not a resend. */
+static int rx_merge(rx_result *acc, rx_result *more, const char *path, ctr_session *cph){
+    if(acc->rc == 0 || !more->cipher) return 0;
+    if(!acc->cipher){
+        rx_result_free(acc);
+        *acc = *more;
+        memset(more, 0, sizeof(*more));
+        return 0;
+    }
+    if(!acc->pkt || !more->pkt || acc->clen != more->clen || acc->code != more->code || acc->mod != more->mod
+       || acc->has_iv != more->has_iv || memcmp(acc->iv, more->iv, CTR_IV_LEN) != 0){
+        rx_err(acc, "%s: not a resend of this message", path);
+        return -1;
+    }
+
+    for(int k=0;k<acc->npkt;k++){
+        if(acc->have[k] || !more->have[k]) continue;
+        memcpy(acc->cipher + (size_t)k*PKT_PAYLOAD, more->cipher + (size_t)k*PKT_PAYLOAD, PKT_PAYLOAD);
+        acc->have[k] = 1;
+        acc->ngood++;
+    }
+    acc->err[0] = 0;
+    rx_decrypt(cph, acc);
+    return 0;
+}
+
+/* Whole-signal search and decode of x[0..n), normalized and band-passed;
+ * takes ownership of x. Sync positions stay at the demod rate. */
+static void decode_signal(const rx_profile *prof, float *x, int n, int threads, ctr_session *cph,
+                          rx_queue *q, rx_result *res){
+    if(prof->decim){
+        /* zero-pad by one delay line so the last inputs reach the output */
+        float *xp = (float*)realloc(x, ((size_t)n + RS_TAPS)*sizeof(float));
+        long long cap = ((long long)n + RS_TAPS) * prof->rs.L / prof->rs.M + 1;
+        float *y = xp ? (float*)malloc((size_t)cap*sizeof(float)) : NULL;
+        if(!y){ free(xp ? xp : x); rx_err(res, "Out of memory (decimator)"); return; }
+        memset(xp + n, 0, RS_TAPS*sizeof(float));
+
+        resampler rs = prof->rs;
+        int st = stats_enter(RXS_DECIMATE);
+        n = (int)resample_run(&rs, xp, (long long)n + RS_TAPS, y, cap);
+        stats_leave(st);
+        free(xp);
+        x = y;
+    }
+
+    long long tail = (long long)RX_TAIL_BITS * prof->spb;
+    float *xt = (float*)realloc(x, ((size_t)n + (size_t)tail)*sizeof(float));
+    if(!xt){ free(x); rx_err(res, "Out of memory (signal)"); return; }
+    x = xt;
+    memset(x + n, 0, (size_t)tail*sizeof(float));
+
+    long long search_max = (long long)lround(SEARCH_SECONDS * prof->fs_dm);
+    if(search_max > n) search_max = n;
+
+    res->pre_bits = prof->pre_bits;
+    acquire_sync(&prof->dm, x, n, search_max, prof->pre_bits, threads, &res->sync);
+    if(res->sync.pos >= 0) res->snr_db = preamble_snr(&prof->dm, x, n, res->sync.pos, prof->pre_bits, res->sync.invert);
+
+    rx_src src;
+    memset(&src, 0, sizeof(src));
+    src.x = x; src.n = n + tail;
+    finish_frame(prof, &src, cph, q, res);
+
+    free(x);
+}
+
+/* ---------- Decoder ---------- */
+struct pc_decoder {
+    pc_decoder_config cfg;
+    const rx_profile *prof;
+    int failed;             /* no more decoding: reason in res.err */
+    int finished;
+    int done;               /* stream mode: frame decoded (or given up) */
+    rx_result res;
+    ctr_session cph;
+    rx_queue q;             /* progressive: plaintext not pulled yet */
+    size_t plain_rd;        /* bytes of res.plain pulled */
+
+    /* whole mode: the downmixed input */
+    float *x;
+    long long n, cap;
+
+    /* stream mode */
+    rx_src src;
+    resampler rs;           /* decimating: src.rs */
+    float *blk;             /* < RX_BLOCK interleaved frames not taken in yet */
+    long long pend;
+    float *mono;            /* decimating: a block before the resampler */
+    long long overlap, tail;
+    int hunting;            /* 0: the frame decoder runs on f */
+    rx_frame f;
+
+    /* split: one plane per channel, sum | sq per channel, the lines */
+    float **plane;
+    double *acc;
+    pc_decoder **lines;
+    int nlines;
+};
+
+/* The stats clock runs inside the decoder's calls only, so time the
+ * caller spends between pushes (reading its input) is not charged */
+static rx_stats *dec_enter(pc_decoder *d){
+    rx_stats *prev = t_stats;
+    if(d->cfg.stats){
+        rx_stats_resume(&d->res.stats);
+        stats_bind(&d->res.stats);
+    }
+    else stats_bind(NULL);
+    return prev;
+}
+
+static void dec_leave(rx_stats *prev){
+    if(t_stats) rx_stats_switch(t_stats, RXS_OTHER);
+    stats_bind(prev);
+}
+
+static int dec_fail(pc_decoder *d, const char *what){
+    rx_err(&d->res, "%s", what);
+    d->failed = 1;
+    return PC_ENOMEM;
+}
+
+void pc_decoder_defaults(pc_decoder_config *cfg){
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->samplerate = PC_SAMPLE_RATE;
+    cfg->channels = 1;
+    cfg->threads = 1;
+    cfg->jobs = 1;
+}
+
+/* ---- Whole mode ---- */
+static int whole_push(pc_decoder *d, const float *frames, long long n){
+    int ch = d->cfg.channels;
+    if(d->n + n > RX_MAX_SAMPLES){
+        rx_err(&d->res, "Capture too long");
+        d->failed = 1;
+        return PC_ERANGE;
+    }
+    if(d->n + n > d->cap){
+        long long cap = d->cap ? d->cap : 65536;
+        while(cap < d->n + n) cap *= 2;
+        if(cap > RX_MAX_SAMPLES) cap = RX_MAX_SAMPLES;
+        float *x = (float*)realloc(d->x, (size_t)cap*sizeof(float));
+        if(!x) return dec_fail(d, "Out of memory (signal)");
+        d->x = x;
+        d->cap = cap;
+    }
+
+    int st = stats_enter(RXS_LOAD);
+    float *mono = d->x + d->n;
+    for(long long i=0;i<n;i++){
+        double sum=0.0;
+        for(int c=0;c<ch;c++) sum += frames[i*ch + c];
+        mono[i]=(float)(sum/ch);
+    }
+    d->n += n;
+    stats_leave(st);
+    return PC_OK;
+}
+
+static void whole_finish(pc_decoder *d){
+    if(d->n == 0){ rx_err(&d->res, "No input samples"); return; }
+
+    frontend fe = d->prof->fe;
+    int st = stats_enter(RXS_FRONTEND);
+    frontend_normalize(&fe, d->x, (int)d->n);
+    stats_leave(st);
+    decode_signal(d->prof, d->x, (int)d->n, d->cfg.threads, &d->cph, d->cfg.progressive ? &d->q : NULL, &d->res);
+    d->x = NULL;
+}
+
+/* ---- Stream mode ----
+ * No global DC/RMS pass: decisions compare bin energies, so they are scale
+ * invariant, and the 700 Hz high-pass removes DC. Pushed frames are taken
+ * in RX_BLOCK at a time (fewer where the window has less room), so the
+ * window sees the same blocks however the caller splits its input. */
+static int stream_init(pc_decoder *d){
+    const rx_profile *p = d->prof;
+    rx_src *s = &d->src;
+
+    /* a preamble starting before the kept overlap is fully inside the window */
+    d->overlap = (2LL*p->pre_bits + 4*8*REP + 4) * p->spb;
+    d->tail = (long long)RX_TAIL_BITS * p->spb;
+    d->hunting = 1;
+    d->res.pre_bits = p->pre_bits;
+
+    s->cap = RX_HUNT_FACTOR * d->overlap;
+    s->x = (float*)malloc((size_t)s->cap*sizeof(float));
+    s->fe = p->fe;
+    d->blk = (float*)malloc((size_t)RX_BLOCK*(size_t)d->cfg.channels*sizeof(float));
+    if(p->decim){
+        d->rs = p->rs;
+        s->rs = &d->rs;
+        d->mono = (float*)malloc((size_t)RX_BLOCK*sizeof(float));
+    }
+    if(!s->x || !d->blk || (p->decim && !d->mono)) return dec_fail(d, "Out of memory (stream buffers)");
+    return PC_OK;
+}
+
+/* Downmix the first k pending frames onto the window */
+static void stream_take(pc_decoder *d, long long k){
+    rx_src *s = &d->src;
+    int ch = d->cfg.channels;
+    float *mono = s->rs ? d->mono : s->x + s->n;
+
+    int st = stats_enter(RXS_LOAD);
+    for(long long i=0;i<k;i++){
+        double sum=0.0;
+        for(int c=0;c<ch;c++) sum += d->blk[i*ch + c];
+        mono[i]=(float)(sum/ch);
+    }
+    d->pend -= k;
+    memmove(d->blk, d->blk + k*ch, (size_t)(d->pend*ch)*sizeof(float));
+    stats_leave(st);
+    src_push(s, mono, k);
+}
+
+/* Hunt over the window; a better preamble is kept even without its MAGIC */
+static void stream_hunt(pc_decoder *d){
+    rx_src *s = &d->src;
+    sync_result *r = &d->res.sync, t;
+    acquire_sync(&d->prof->dm, s->x, s->n, s->n, d->prof->pre_bits, d->cfg.threads, &t);
+    if(t.c.off >= 0 && (t.c.score > r->c.score || t.pos >= 0)){
+        *r = t;
+        r->c.off += s->base;
+        if(t.pos >= 0){
+            d->res.snr_db = preamble_snr(&d->prof->dm, s->x, s->n, t.pos, d->prof->pre_bits, t.invert);
+            r->pos += s->base;
+            d->hunting = 0;
+            frame_start(&d->f, r->pos, r->invert);
+        }
+    }
+}
+
+/* Run the frame decoder on what the window holds; 1 once the frame is done */
+static int stream_frame(pc_decoder *d, int eof){
+    rx_queue *q = d->cfg.progressive ? &d->q : NULL;
+    if(!frame_run(&d->f, d->prof, &d->src, &d->cph, q, eof, &d->res)) return 0;
+    frame_end(&d->f, &d->cph, q, &d->res);
+    d->done = 1;
+    return 1;
+}
+
+/* Window full: drop all but the overlap if the hunt did not find the
+ * frame, else everything before the frame decoder's position */
+static void stream_full(pc_decoder *d){
+    rx_src *s = &d->src;
+    if(d->hunting){
+        stream_hunt(d);
+        if(d->hunting) src_drop(s, s->n - d->overlap);
+    }
+    else if(!stream_frame(d, 0)) src_drop(s, d->f.pos - s->base);
+}
+
+/* Take in pending frames while whole blocks are there (at eof also the
+ * rest) */
+static void stream_run(pc_decoder *d, int eof){
+    while(!d->done && !d->failed){
+        long long fit = src_fit(&d->src);
+        if(fit <= 0){ stream_full(d); continue; }
+        if(d->pend == 0 || (d->pend < fit && !eof)) break;
+        stream_take(d, (d->pend < fit) ? d->pend : fit);
+        if(!d->hunting) stream_frame(d, 0);
+    }
+}
+
+static int stream_push(pc_decoder *d, const float *frames, long long n){
+    int ch = d->cfg.channels;
+    while(n > 0 && !d->done && !d->failed){
+        long long k = RX_BLOCK - d->pend;
+        if(k > n) k = n;
+        memcpy(d->blk + d->pend*ch, frames, (size_t)(k*ch)*sizeof(float));
+        d->pend += k;
+        frames += k*ch;
+        n -= k;
+        stream_run(d, 0);
+    }
+    return PC_OK;
+}
+
+static void stream_finish(pc_decoder *d){
+    rx_src *s = &d->src;
+    stream_run(d, 1);
+    while(!d->done && src_fit(s) <= 0) stream_full(d);
+    if(d->done) return;
+
+    /* end of input: flush the decimator's delay line, then append the tail */
+    long long room = s->cap - s->n;
+    if(s->rs){
+        long long fit = src_fit(s);
+        long long z = (fit < RS_TAPS) ? fit : RS_TAPS;
+        int st = stats_enter(RXS_DECIMATE);
+        memset(d->mono, 0, (size_t)z*sizeof(float));
+        s->n += resample_run(s->rs, d->mono, z, s->x + s->n, room);
+        stats_leave(st);
+        room = s->cap - s->n;
+    }
+    long long z = (d->tail < room) ? d->tail : room;
+    memset(s->x + s->n, 0, (size_t)z*sizeof(float));
+    s->n += z;
+
+    if(d->hunting && s->n > 0) stream_hunt(d);
+    if(d->hunting) sync_fail(&d->res);
+    else stream_frame(d, 1);
+    d->done = 1;
+}
+/* ---------- Multichannel capture (split) ---------- */
+/* Every channel of the capture is its own line: the pushed frames are
+ * kept as one plane per channel while the mean and RMS of each are summed;
+ * at finish the planes go through a bank of band-pass filters with one
+ * state per channel, RX_BLOCK interleaved frames at a time. The biquad
+ * recursion is serial in time, but the channels are independent, so SIMD
+ * lanes are channels (AVX2: four per vector, same operations as
+ * frontend_run, so the same samples). Each plane is then searched and
+ * decoded on its own (its own sync, offsets and result) by the workers. */
+typedef void (*bank_fn)(frontend *fe, float *x, int ch, long long k, const double *dc, const double *g);
+
+static void bank_ref(frontend *fe, float *x, int ch, long long k, const double *dc, const double *g){
+    for(int c=0;c<ch;c++) frontend_run(&fe[c], x + c, ch, k, dc[c], g[c]);
+}
+
+#if defined(RX_HAVE_AVX2)
+/* Eight channels per pass where there are (two independent recursions
+ * hide the add latency), then four, then the reference for the rest */
+__attribute__((target("avx2")))
+static void bank_avx2(frontend *fe, float *x, int ch, long long k, const double *dc, const double *g){
+    const biquad h = fe[0].hp, l = fe[0].lp;
+    const __m256d hb0 = _mm256_set1_pd(h.b0), hb1 = _mm256_set1_pd(h.b1), hb2 = _mm256_set1_pd(h.b2);
+    const __m256d ha1 = _mm256_set1_pd(h.a1), ha2 = _mm256_set1_pd(h.a2);
+    const __m256d lb0 = _mm256_set1_pd(l.b0), lb1 = _mm256_set1_pd(l.b1), lb2 = _mm256_set1_pd(l.b2);
+    const __m256d la1 = _mm256_set1_pd(l.a1), la2 = _mm256_set1_pd(l.a2);
+    int c0 = 0;
+
+    while(ch - c0 >= 4){
+        int w = (ch - c0 >= 8) ? 2 : 1;
+        __m256d st[2][4], vdc[2], vg[2];
+        for(int j=0;j<w;j++){
+            const frontend *f = fe + c0 + 4*j;
+            st[j][0] = _mm256_setr_pd(f[0].hp.z1, f[1].hp.z1, f[2].hp.z1, f[3].hp.z1);
+            st[j][1] = _mm256_setr_pd(f[0].hp.z2, f[1].hp.z2, f[2].hp.z2, f[3].hp.z2);
+            st[j][2] = _mm256_setr_pd(f[0].lp.z1, f[1].lp.z1, f[2].lp.z1, f[3].lp.z1);
+            st[j][3] = _mm256_setr_pd(f[0].lp.z2, f[1].lp.z2, f[2].lp.z2, f[3].lp.z2);
+            vdc[j] = _mm256_loadu_pd(dc + c0 + 4*j);
+            vg[j] = _mm256_loadu_pd(g + c0 + 4*j);
+        }
+
+        float *p = x + c0;
+        for(long long i=0;i<k;i++, p+=ch){
+            for(int j=0;j<w;j++){
+                __m256d in = _mm256_mul_pd(_mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(p + 4*j)), vdc[j]), vg[j]);
+                __m256d mid = _mm256_add_pd(_mm256_mul_pd(hb0, in), st[j][0]);
+                st[j][0] = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(hb1, in), _mm256_mul_pd(ha1, mid)), st[j][1]);
+                st[j][1] = _mm256_sub_pd(_mm256_mul_pd(hb2, in), _mm256_mul_pd(ha2, mid));
+                __m256d out = _mm256_add_pd(_mm256_mul_pd(lb0, mid), st[j][2]);
+                st[j][2] = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(lb1, mid), _mm256_mul_pd(la1, out)), st[j][3]);
+                st[j][3] = _mm256_sub_pd(_mm256_mul_pd(lb2, mid), _mm256_mul_pd(la2, out));
+                _mm_storeu_ps(p + 4*j, _mm256_cvtpd_ps(out));
+            }
+        }
+
+        for(int j=0;j<w;j++){
+            double t[4][4];
+            for(int q=0;q<4;q++) _mm256_storeu_pd(t[q], st[j][q]);
+            for(int m=0;m<4;m++){
+                frontend *f = fe + c0 + 4*j + m;
+                f->hp.z1 = t[0][m]; f->hp.z2 = t[1][m];
+                f->lp.z1 = t[2][m]; f->lp.z2 = t[3][m];
+            }
+        }
+        c0 += 4*w;
+    }
+    for(int c=c0;c<ch;c++) frontend_run(&fe[c], x + c, ch, k, dc[c], g[c]);
+}
+#endif
+
+static bank_fn pick_bank(int simd){
+    if(!simd) return bank_ref;
+#if defined(RX_HAVE_AVX2)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) return bank_avx2;
+#endif
+    return bank_ref;
+}
+
+static int split_push(pc_decoder *d, const float *frames, long long n){
+    int ch = d->cfg.channels;
+    if(d->n + n > RX_MAX_SAMPLES){
+        rx_err(&d->res, "Capture too long");
+        d->failed = 1;
+        return PC_ERANGE;
+    }
+    if(d->n + n > d->cap){
+        long long cap = d->cap ? d->cap : 65536;
+        while(cap < d->n + n) cap *= 2;
+        if(cap > RX_MAX_SAMPLES) cap = RX_MAX_SAMPLES;
+        for(int c=0;c<ch;c++){
+            float *x = (float*)realloc(d->plane[c], (size_t)cap*sizeof(float));
+            if(!x) return dec_fail(d, "Out of memory (channels)");
+            d->plane[c] = x;
+        }
+        d->cap = cap;
+    }
+
+    /* per-channel sums for the mean and RMS (same sums as frontend_normalize) */
+    int st = stats_enter(RXS_LOAD);
+    double *sum = d->acc, *sq = d->acc + ch;
+    for(long long i=0;i<n;i++){
+        const float *f = frames + i*ch;
+        for(int c=0;c<ch;c++){
+            double v = f[c];
+            sum[c] += v;
+            sq[c] += v*v;
+            d->plane[c][d->n + i] = f[c];
+        }
+    }
+    d->n += n;
+    stats_leave(st);
+    return PC_OK;
+}
+
+typedef struct {
+    pc_decoder *d;
+    int threads;        /* sweep threads per line */
+    atomic_int next;
+} split_pool;
+
+static void *split_worker(void *arg){
+    split_pool *sp = (split_pool*)arg;
+    pc_decoder *d = sp->d;
+    rx_stats *prev = t_stats;
+
+    for(;;){
+        int i = atomic_fetch_add(&sp->next, 1);
+        if(i >= d->nlines) break;
+        pc_decoder *l = d->lines[i];
+        float *x = d->plane[i];
+        d->plane[i] = NULL;
+        if(l->cfg.stats){
+            rx_stats_start(&l->res.stats);
+            stats_bind(&l->res.stats);
+        }
+        else stats_bind(NULL);
+        decode_signal(l->prof, x, (int)d->n, sp->threads, &l->cph, NULL, &l->res);
+        dec_leave(prev);
+        l->finished = 1;
+    }
+    return NULL;
+}
+
+/* Filter bank over the planes, RX_BLOCK interleaved frames at a time, then
+ * each plane decoded as a line of its own on min(jobs, lines) workers; the
+ * threads not used by the workers go to each line's offset sweep */
+static void split_finish(pc_decoder *d){
+    int ch = d->cfg.channels;
+    if(d->n == 0){ rx_err(&d->res, "No input samples"); return; }
+
+    float *blk = (float*)malloc((size_t)RX_BLOCK*(size_t)ch*sizeof(float));
+    frontend *fe = (frontend*)malloc((size_t)ch*sizeof(frontend));
+    double *dg = (double*)malloc((size_t)ch*2*sizeof(double));   /* dc | g */
+    d->lines = (pc_decoder**)calloc((size_t)ch, sizeof(pc_decoder*));
+    int ok = blk && fe && dg && d->lines;
+    for(int c=0;ok && c<ch;c++){
+        pc_decoder *l = (pc_decoder*)calloc(1, sizeof(pc_decoder));
+        if(!(ok = l != NULL)) break;
+        l->cfg = d->cfg;
+        l->cfg.channels = 1;
+        l->cfg.split = 0;
+        l->prof = d->prof;
+        rx_result_reset(&l->res);
+        ctr_init(&l->cph, ctr_key);
+        d->lines[c] = l;
+        d->nlines++;
+    }
+    if(!ok){ dec_fail(d, "Out of memory (channels)"); goto done; }
+
+    double *sum = d->acc, *sq = d->acc + ch, *dc = dg, *g = dg + ch;
+    for(int c=0;c<ch;c++){
+        double mean = sum[c] / (double)d->n;
+        double var = sq[c] / (double)d->n - mean*mean;
+        double rms = sqrt(var > 0.0 ? var : 0.0);
+        dc[c] = mean;
+        g[c] = (rms < 1e-6) ? 1.0 : RX_TARGET_RMS / rms;
+        fe[c] = d->prof->fe;
+    }
+
+    int st = stats_enter(RXS_FRONTEND);
+    bank_fn bank = pick_bank(!d->cfg.scalar);
+    for(long long at=0;at<d->n;at+=RX_BLOCK){
+        long long k = (d->n - at < RX_BLOCK) ? d->n - at : RX_BLOCK;
+        for(int c=0;c<ch;c++){
+            const float *src = d->plane[c] + at;
+            for(long long i=0;i<k;i++) blk[i*ch + c] = src[i];
+        }
+        bank(fe, blk, ch, k, dc, g);
+        for(int c=0;c<ch;c++){
+            float *dst = d->plane[c] + at;
+            for(long long i=0;i<k;i++) dst[i] = blk[i*ch + c];
+        }
+    }
+    stats_leave(st);
+
+    split_pool sp;
+    int jobs = d->cfg.jobs;
+    if(jobs > ch) jobs = ch;
+    if(jobs > RX_MAX_THREADS) jobs = RX_MAX_THREADS;
+    sp.d = d;
+    sp.threads = (d->cfg.threads / jobs > 1) ? d->cfg.threads / jobs : 1;
+    atomic_init(&sp.next, 0);
+
+    pthread_t tid[RX_MAX_THREADS];
+    int started = 0;
+    for(int t=1;t<jobs;t++){
+        if(pthread_create(&tid[started], NULL, split_worker, &sp) != 0) break;
+        started++;
+    }
+    split_worker(&sp);
+    for(int t=0;t<started;t++) pthread_join(tid[t], NULL);
+
+done:
+    free(dg);
+    free(fe);
+    free(blk);
+}
+
+/* ---------- Decoder API ---------- */
+pc_decoder *pc_decoder_new(const pc_decoder_config *cfg){
+    pthread_once(&g_once, pc_init_once);
+    if(!cfg || cfg->samplerate <= 0 || cfg->channels <= 0 || cfg->frames < 0
+       || (cfg->split && (cfg->stream || cfg->progressive))) return NULL;
+
+    pc_decoder *d = (pc_decoder*)calloc(1, sizeof(pc_decoder));
+    if(!d) return NULL;
+    d->cfg = *cfg;
+    if(d->cfg.threads < 1) d->cfg.threads = 1;
+    if(d->cfg.jobs < 1) d->cfg.jobs = 1;
+#ifdef RX_NO_STATS
+    d->cfg.stats = 0;
+#endif
+    rx_result_reset(&d->res);
+    ctr_init(&d->cph, ctr_key);
+    if(d->cfg.stats) rx_stats_start(&d->res.stats);
+
+    rx_stats *prev = dec_enter(d);
+    int flags = (cfg->decimate ? RXP_DECIMATE : 0) | (cfg->hard ? RXP_HARD : 0) | (cfg->scalar ? RXP_SCALAR : 0);
+    int rc = PC_OK;
+    d->prof = get_profile(cfg->samplerate, flags, &d->res);
+    if(!d->prof) d->failed = 1;
+    else if(cfg->stream) rc = stream_init(d);
+    else {
+        long long cap = (cfg->frames <= RX_MAX_SAMPLES) ? cfg->frames : 0;
+        if(cfg->split){
+            d->plane = (float**)calloc((size_t)cfg->channels, sizeof(float*));
+            d->acc = (double*)calloc((size_t)cfg->channels*2, sizeof(double));
+            if(!d->plane || !d->acc) rc = PC_ENOMEM;
+            for(int c=0;rc == PC_OK && cap > 0 && c<cfg->channels;c++)
+                if(!(d->plane[c] = (float*)malloc((size_t)cap*sizeof(float)))) rc = PC_ENOMEM;
+        }
+        else if(cap > 0 && !(d->x = (float*)malloc((size_t)cap*sizeof(float)))) rc = PC_ENOMEM;
+        if(rc == PC_OK) d->cap = cap;
+    }
+    dec_leave(prev);
+
+    if(rc != PC_OK){
+        pc_decoder_free(d);
+        return NULL;
+    }
+    return d;
+}
+
+int pc_decoder_push(pc_decoder *d, const float *frames, long long n){
+    if(d->finished) return PC_ESTATE;
+    if(n < 0 || (n > 0 && !frames)) return PC_EINVAL;
+    if(d->failed || n == 0) return PC_OK;
+
+    rx_stats *prev = dec_enter(d);
+    int rc;
+    if(d->cfg.stream) rc = stream_push(d, frames, n);
+    else if(d->cfg.split) rc = split_push(d, frames, n);
+    else rc = whole_push(d, frames, n);
+    dec_leave(prev);
+    return rc;
+}
+
+int pc_decoder_finish(pc_decoder *d){
+    if(d->finished) return PC_ESTATE;
+    d->finished = 1;
+    if(d->failed) return PC_OK;
+
+    rx_stats *prev = dec_enter(d);
+    if(d->cfg.stream) stream_finish(d);
+    else if(d->cfg.split) split_finish(d);
+    else whole_finish(d);
+    dec_leave(prev);
+    return PC_OK;
+}
+
+long pc_decoder_pull(pc_decoder *d, void *buf, long cap){
+    const unsigned char *src;
+    size_t avail;
+    if(cap <= 0) return 0;
+    if(d->cfg.progressive){
+        src = d->q.b + d->q.rd;
+        avail = d->q.n - d->q.rd;
+    } else {
+        if(!d->finished || !d->res.plain) return 0;
+        src = d->res.plain + d->plain_rd;
+        avail = (size_t)d->res.plen - d->plain_rd;
+    }
+    size_t k = (avail < (size_t)cap) ? avail : (size_t)cap;
+    if(k) memcpy(buf, src, k);
+    if(d->cfg.progressive){
+        d->q.rd += k;
+        if(d->q.rd == d->q.n) d->q.rd = d->q.n = 0;
+    }
+    else d->plain_rd += k;
+    return (long)k;
+}
+
+void pc_decoder_info(const pc_decoder *d, pc_info *info){
+    const rx_result *res = &d->res;
+    sync_result r = res->sync;
+    if(d->prof) sync_to_input(d->prof, &r);
+
+    memset(info, 0, sizeof(*info));
+    info->done = d->finished;
+    info->ok = (d->finished || d->done) && res->rc == 0;
+    for(int i=0;i<d->nlines;i++) if(d->lines[i]->res.rc != 0) info->ok = 0;
+    info->sync_off = r.c.off;
+    info->sync_inv = r.c.inv;
+    info->score = r.c.score;
+    info->pre_bits = res->pre_bits;
+    info->pos = r.pos;
+    info->inv = r.invert;
+    info->fec = res->clen ? res->code : -1;
+    info->mod = res->clen ? res->mod : -1;
+    info->rate = res->clen ? res->rate : -1;
+    info->snr_db = res->snr_db;
+    info->packetized = res->pkt;
+    info->packets = res->npkt;
+    info->good = res->ngood;
+    info->has_iv = res->has_iv;
+    memcpy(info->iv, res->iv, PC_IV_LEN);
+    info->len = (long)res->clen;
+    if(d->cfg.progressive) info->plain = (long)(d->q.n - d->q.rd);
+    else if(d->finished && res->plain) info->plain = (long)((size_t)res->plen - d->plain_rd);
+    info->error = res->err;
+    info->stats = d->cfg.stats ? &res->stats : NULL;
+}
+
+int pc_decoder_lines(const pc_decoder *d){
+    return d->nlines;
+}
+
+pc_decoder *pc_decoder_line(pc_decoder *d, int i){
+    return (i >= 0 && i < d->nlines) ? d->lines[i] : NULL;
+}
+
+int pc_decoder_merge(pc_decoder *d, pc_decoder *more, const char *name){
+    if(!d->finished || !more->finished || d->cfg.progressive) return PC_ESTATE;
+
+    /* d takes more's result whole if it has none of its own */
+    const rx_profile *mp = more->prof;
+    int take = d->res.rc != 0 && !d->res.cipher && more->res.cipher;
+    rx_stats *prev = dec_enter(d);
+    int rc = rx_merge(&d->res, &more->res, name ? name : "", &d->cph);
+    dec_leave(prev);
+    if(take){
+        d->prof = mp;
+        rx_result_reset(&more->res);
+    }
+    d->plain_rd = 0;
+    return rc ? PC_EINVAL : PC_OK;
+}
+
+void pc_decoder_free(pc_decoder *d){
+    if(!d) return;
+    for(int i=0;i<d->nlines;i++) pc_decoder_free(d->lines[i]);
+    free(d->lines);
+    if(d->plane){
+        for(int c=0;c<d->cfg.channels;c++) free(d->plane[c]);
+        free(d->plane);
+    }
+    free(d->acc);
+    frame_free(&d->f);
+    free(d->mono);
+    free(d->blk);
+    free(d->src.x);
+    free(d->x);
+    free(d->q.b);
+    rx_result_free(&d->res);
+    ctr_free(&d->cph);
+    free(d);
+}
+
+void pc_cleanup(void){
+    pthread_mutex_lock(&g_profile_lock);
+    free_profiles();
+    pthread_mutex_unlock(&g_profile_lock);
+}
+
+/* ---------- Channel simulator ---------- */
+int pc_channel_preset(const char *name){
+    return chan_find(chan_preset_names, name);
+}
+
+int pc_channel_noise(const char *name){
+    return chan_find(chan_noise_names, name);
+}
+
+long long pc_channel_length(long long n, int samplerate, int preset){
+    if(preset < CHAN_NONE || preset > CHAN_LOWBIT || samplerate <= 0 || n < 0) return PC_EINVAL;
+    return chan_out_len(n, samplerate, preset);
+}
+
+int pc_channel_apply(int preset, int noise, double snr_db, unsigned long long seed,
+                     const float *x, long long n, int samplerate, float *out){
+    if(pc_channel_length(n, samplerate, preset) < 0 || noise < CHAN_AWGN || noise > CHAN_MIX) return PC_EINVAL;
+    return chan_apply(preset, noise, snr_db, seed, x, n, samplerate, out) == 0 ? PC_OK : PC_ENOMEM;
+}
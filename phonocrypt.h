@@ -0,0 +1,163 @@
+/*
+ * phonocrypt.h - in-process encoder and decoder (libphonocrypt)
+ *
+ * The sender and receiver tools are thin wrappers around these calls:
+ * framing, CRCs, AES-256-CTR, modulation and the whole receive chain
+ * (front end, sync, demodulation, channel decoding) live in phonocrypt.c,
+ * which has no file I/O. Build it into the program that uses it:
+ *   gcc app.c phonocrypt.c -o app -lssl -lcrypto -lm -lpthread
+ *
+ * Encoder: configure, push the message bytes, pull float samples at
+ * PC_SAMPLE_RATE (unclamped, peak around 0.87) until pull returns 0.
+ *   pc_encoder *e = pc_encoder_new(NULL);
+ *   pc_encoder_push(e, msg, len);
+ *   while((n = pc_encoder_pull(e, buf, cap)) > 0) ...
+ *   pc_encoder_free(e);
+ *
+ * Decoder: configure the input format, push interleaved float frames as
+ * they arrive, finish at the end of the input, pull the plaintext. In
+ * stream mode memory stays bounded and the frame is decoded while
+ * samples arrive; with progressive set, pull returns packet plaintext as
+ * each packet passes its CRC ('?' for lost ones), before finish.
+ * With split set every channel is a line of its own, decoded at finish
+ * on a pool of workers; pc_decoder_line() gives their results.
+ *   pc_decoder *d = pc_decoder_new(&cfg);
+ *   pc_decoder_push(d, frames, n); ...
+ *   pc_decoder_finish(d);
+ *   pc_decoder_info(d, &info);  pc_decoder_pull(d, buf, cap);
+ *   pc_decoder_free(d);
+ *
+ * Objects are not shared between threads; distinct objects can be used
+ * from any number of threads at once. Per-rate DSP tables are built on
+ * first use and shared by all decoders until pc_cleanup().
+ * Functions returning int give PC_OK or a negative PC_E* code.
+ */
+#ifndef PHONOCRYPT_H
+#define PHONOCRYPT_H
+
+#include <stddef.h>
+#include "rxstats.h"
+
+#define PC_SAMPLE_RATE  44100   /* encoder output rate */
+#define PC_IV_LEN       16
+#define PC_MAX_LEN      ((1 << 21) - 1)  /* message bytes a frame can carry */
+
+#define PC_OK           0
+#define PC_ENOMEM       (-1)
+#define PC_EINVAL       (-2)    /* bad argument or configuration */
+#define PC_ESTATE       (-3)    /* call not valid in this state */
+#define PC_ETOOLONG     (-4)    /* message too long for the frame (or for packets) */
+#define PC_ERANGE       (-5)    /* resend packet not in the message */
+#define PC_ECRYPTO      (-6)
+#define PC_ERANDOM      (-7)    /* no random IV */
+
+/* Body codes and modulations (fec.h, modem.h ids) */
+#define PC_FEC_REP      0
+#define PC_FEC_CONV     1
+#define PC_MOD_BFSK     0
+#define PC_MOD_4FSK     1
+#define PC_MOD_8FSK     2
+#define PC_MOD_MC4      3
+
+/* Body symbol rates (modem.h ids): the preamble and header stay at 15 ms,
+ * the body symbols are 15, 10, 7.5, 5 or 3.75 ms (8fsk / mc4 need 10 ms or
+ * more, 4fsk 5 ms) */
+#define PC_RATE_15MS    0
+#define PC_RATE_10MS    1
+#define PC_RATE_7MS5    2
+#define PC_RATE_5MS     3
+#define PC_RATE_3MS75   4
+
+typedef struct pc_encoder pc_encoder;
+typedef struct pc_decoder pc_decoder;
+
+typedef struct {
+    int fec;                    /* PC_FEC_* (default conv) */
+    int mod;                    /* PC_MOD_* (default bfsk) */
+    int rate;                   /* PC_RATE_* of the body (default 15ms) */
+    int packets;                /* body as CRC'd packets (packet.h) */
+    const unsigned *resend;     /* packets: send only these seqs, NULL: all */
+    size_t nresend;
+    const unsigned char *iv;    /* PC_IV_LEN bytes (a resend), NULL: random */
+    int fixed_iv;               /* demo IV and no IV block, as older senders */
+} pc_encoder_config;
+
+typedef struct {
+    int samplerate, channels;   /* of the pushed frames */
+    long long frames;           /* expected frames, 0 if unknown (a size hint) */
+    int stream;                 /* bounded memory, decode while samples arrive */
+    int progressive;            /* pull packet plaintext as packets arrive */
+    int split;                  /* each channel is its own line (not with stream) */
+    int threads;                /* threads of the exhaustive preamble sweep */
+    int jobs;                   /* split: lines decoded at once */
+    int decimate;               /* demodulate at ~11 kHz after the band-pass */
+    int hard;                   /* REP majority vote instead of soft sums */
+    int scalar;                 /* reference correlator, no SIMD kernels */
+    int stats;                  /* collect telemetry (rxstats.h) */
+} pc_decoder_config;
+
+typedef struct {
+    int done;                   /* finished: nothing below changes any more */
+    int ok;                     /* the whole plaintext was recovered */
+    long long sync_off;         /* preamble start, input samples (-1: none) */
+    int sync_inv, score, pre_bits;
+    long long pos;              /* frame start, input samples (-1: no MAGIC) */
+    int inv;
+    int fec, mod, rate;         /* body format from the header */
+    double snr_db;              /* preamble SNR per 15 ms bin (NAN: no frame) */
+    int packetized, packets, good;
+    int has_iv;                 /* IV sent in the frame (else the fixed one) */
+    unsigned char iv[PC_IV_LEN];
+    long len;                   /* message bytes from the header */
+    long plain;                 /* plaintext bytes pull can give now */
+    const char *error;          /* failure reasons, one line each */
+    const rx_stats *stats;      /* NULL unless stats was set */
+} pc_info;
+
+const char *pc_strerror(int err);
+const char *pc_fec_name(int fec);          /* NULL if unknown */
+int pc_fec_find(const char *name);         /* -1 if unknown */
+const char *pc_mod_name(int mod);
+int pc_mod_find(const char *name);
+const char *pc_rate_name(int rate);
+int pc_rate_find(const char *name);
+int pc_rate_fits(int rate, int mod);       /* the modulation's tones stay apart */
+/* Probe: the fastest rate at which fec/mod is still safe on a link whose
+ * preamble measured snr_db (pc_info), -1 if even 15 ms is not */
+int pc_rate_advise(double snr_db, int fec, int mod);
+size_t pc_packet_count(size_t len);        /* packets of a len-byte message */
+void pc_cleanup(void);                     /* free the shared DSP tables */
+
+void pc_encoder_defaults(pc_encoder_config *cfg);
+pc_encoder *pc_encoder_new(const pc_encoder_config *cfg);      /* NULL: defaults */
+int pc_encoder_push(pc_encoder *e, const void *msg, size_t len);
+int pc_encoder_start(pc_encoder *e);       /* frame what was pushed (pull does it too) */
+long pc_encoder_pull(pc_encoder *e, float *out, long cap);     /* samples, 0 at the end */
+long long pc_encoder_length(const pc_encoder *e);               /* samples in all, once started */
+const unsigned char *pc_encoder_iv(const pc_encoder *e);       /* once started */
+void pc_encoder_free(pc_encoder *e);
+
+void pc_decoder_defaults(pc_decoder_config *cfg);
+pc_decoder *pc_decoder_new(const pc_decoder_config *cfg);      /* NULL: OOM or bad config */
+int pc_decoder_push(pc_decoder *d, const float *frames, long long n);
+int pc_decoder_finish(pc_decoder *d);
+long pc_decoder_pull(pc_decoder *d, void *buf, long cap);      /* plaintext bytes */
+void pc_decoder_info(const pc_decoder *d, pc_info *info);
+int pc_decoder_lines(const pc_decoder *d);                     /* split: lines, after finish */
+pc_decoder *pc_decoder_line(pc_decoder *d, int i);             /* owned by d */
+/* Packets of a later transmission of the same message (a resend, decoded
+ * by more) fill the gaps; name labels more in the error text. PC_EINVAL
+ * if more is not a resend of d's message. */
+int pc_decoder_merge(pc_decoder *d, pc_decoder *more, const char *name);
+void pc_decoder_free(pc_decoder *d);
+
+/* Channel simulator (channel.h): Tester.py's compression presets and noise
+ * types on a mono signal at samplerate. out needs pc_channel_length()
+ * samples; the same seed gives the same output. */
+int pc_channel_preset(const char *name);   /* none|voip|pstn|lowbit, -1 if unknown */
+int pc_channel_noise(const char *name);    /* awgn|pink|hum|clicks|mix, -1 if unknown */
+long long pc_channel_length(long long n, int samplerate, int preset);
+int pc_channel_apply(int preset, int noise, double snr_db, unsigned long long seed,
+                     const float *x, long long n, int samplerate, float *out);
+
+#endif
@@ -0,0 +1,223 @@
+"""ctypes binding of libphonocrypt (phonocrypt.h) for in-process tests.
+
+Build the shared library next to this file:
+    gcc -O2 -shared -fPIC phonocrypt.c -o libphonocrypt.so -lssl -lcrypto -lm -lpthread
+
+Samples are passed as float32 buffers (numpy arrays, array('f'), ...) without
+copies: encode() pulls the signal straight into a buffer from alloc, decode()
+pushes the caller's buffer to the decoder as it is.
+"""
+import ctypes
+import os
+from ctypes import (POINTER, c_char_p, c_double, c_float, c_int, c_long, c_longlong, c_size_t, c_ubyte, c_uint,
+                    c_ulonglong, c_void_p)
+from pathlib import Path
+from typing import Callable, Optional
+
+SAMPLE_RATE = 44100
+IV_LEN = 16
+
+class Error(RuntimeError):
+    pass
+
+class EncoderConfig(ctypes.Structure):
+    _fields_ = [
+        ("fec", c_int), ("mod", c_int), ("rate", c_int), ("packets", c_int),
+        ("resend", POINTER(c_uint)), ("nresend", c_size_t),
+        ("iv", POINTER(c_ubyte)), ("fixed_iv", c_int),
+    ]
+
+class DecoderConfig(ctypes.Structure):
+    _fields_ = [
+        ("samplerate", c_int), ("channels", c_int), ("frames", c_longlong),
+        ("stream", c_int), ("progressive", c_int), ("split", c_int),
+        ("threads", c_int), ("jobs", c_int), ("decimate", c_int),
+        ("hard", c_int), ("scalar", c_int), ("stats", c_int),
+    ]
+
+class Info(ctypes.Structure):
+    _fields_ = [
+        ("done", c_int), ("ok", c_int),
+        ("sync_off", c_longlong), ("sync_inv", c_int), ("score", c_int), ("pre_bits", c_int),
+        ("pos", c_longlong), ("inv", c_int),
+        ("fec", c_int), ("mod", c_int), ("rate", c_int), ("snr_db", c_double),
+        ("packetized", c_int), ("packets", c_int), ("good", c_int),
+        ("has_iv", c_int), ("iv", c_ubyte * IV_LEN),
+        ("len", c_long), ("plain", c_long),
+        ("error", c_char_p), ("stats", c_void_p),
+    ]
+
+_lib = None
+
+def load(path: Optional[str] = None) -> ctypes.CDLL:
+    """Load the library once: path, else $PHONOCRYPT_LIB, else next to this file."""
+    global _lib
+    if _lib is not None:
+        return _lib
+    path = path or os.environ.get("PHONOCRYPT_LIB") or str(Path(__file__).resolve().parent / "libphonocrypt.so")
+    lib = ctypes.CDLL(path)
+
+    lib.pc_strerror.restype = c_char_p
+    lib.pc_strerror.argtypes = [c_int]
+    lib.pc_fec_find.argtypes = [c_char_p]
+    lib.pc_mod_find.argtypes = [c_char_p]
+    lib.pc_rate_find.argtypes = [c_char_p]
+    lib.pc_rate_name.restype = c_char_p
+    lib.pc_rate_name.argtypes = [c_int]
+    lib.pc_rate_fits.argtypes = [c_int, c_int]
+    lib.pc_rate_advise.argtypes = [c_double, c_int, c_int]
+
+    lib.pc_encoder_defaults.argtypes = [POINTER(EncoderConfig)]
+    lib.pc_encoder_new.restype = c_void_p
+    lib.pc_encoder_new.argtypes = [POINTER(EncoderConfig)]
+    lib.pc_encoder_push.argtypes = [c_void_p, c_char_p, c_size_t]
+    lib.pc_encoder_start.argtypes = [c_void_p]
+    lib.pc_encoder_pull.restype = c_long
+    lib.pc_encoder_pull.argtypes = [c_void_p, c_void_p, c_long]
+    lib.pc_encoder_length.restype = c_longlong
+    lib.pc_encoder_length.argtypes = [c_void_p]
+    lib.pc_encoder_free.argtypes = [c_void_p]
+    lib.pc_encoder_free.restype = None
+
+    lib.pc_decoder_defaults.argtypes = [POINTER(DecoderConfig)]
+    lib.pc_decoder_new.restype = c_void_p
+    lib.pc_decoder_new.argtypes = [POINTER(DecoderConfig)]
+    lib.pc_decoder_push.argtypes = [c_void_p, c_void_p, c_longlong]
+    lib.pc_decoder_finish.argtypes = [c_void_p]
+    lib.pc_decoder_pull.restype = c_long
+    lib.pc_decoder_pull.argtypes = [c_void_p, c_void_p, c_long]
+    lib.pc_decoder_info.argtypes = [c_void_p, POINTER(Info)]
+    lib.pc_decoder_info.restype = None
+    lib.pc_decoder_free.argtypes = [c_void_p]
+    lib.pc_decoder_free.restype = None
+
+    lib.pc_channel_preset.argtypes = [c_char_p]
+    lib.pc_channel_noise.argtypes = [c_char_p]
+    lib.pc_channel_length.restype = c_longlong
+    lib.pc_channel_length.argtypes = [c_longlong, c_int, c_int]
+    lib.pc_channel_apply.argtypes = [c_int, c_int, c_double, c_ulonglong, c_void_p, c_longlong, c_int, c_void_p]
+    _lib = lib
+    return lib
+
+def _check(lib, rc: int, what: str) -> None:
+    if rc < 0:
+        raise Error(f"{what}: {lib.pc_strerror(rc).decode()}")
+
+def _floats(buf):
+    """(address, float count) of a C-contiguous float32 buffer, not copied"""
+    m = memoryview(buf)
+    if m.format.lstrip("@=<") != "f" or not m.c_contiguous:
+        raise TypeError("samples must be a contiguous float32 buffer")
+    if m.readonly:
+        raise TypeError("samples must be writable (ctypes cannot borrow read-only buffers)")
+    n = m.nbytes // 4
+    return ctypes.addressof((c_float * n).from_buffer(m)), n
+
+def encode(message: bytes, fec: str = "conv", mod: str = "bfsk", packets: bool = False,
+           alloc: Optional[Callable[[int], object]] = None, rate: str = "15ms"):
+    """Frame, encrypt and modulate message at SAMPLE_RATE (random IV), the
+    body at symbol rate (15ms, 10ms, 7.5ms, 5ms, 3.75ms; 8fsk / mc4 need 10ms,
+    4fsk 5ms).
+
+    Returns alloc(n) filled with the n samples, unclamped as the library gives
+    them (alloc defaults to a ctypes float array)."""
+    lib = load()
+    cfg = EncoderConfig()
+    lib.pc_encoder_defaults(ctypes.byref(cfg))
+    cfg.fec = lib.pc_fec_find(fec.encode())
+    cfg.mod = lib.pc_mod_find(mod.encode())
+    cfg.rate = lib.pc_rate_find(rate.encode())
+    cfg.packets = int(packets)
+    if cfg.fec < 0 or cfg.mod < 0 or cfg.rate < 0:
+        raise Error(f"unknown code, modulation or rate: {fec}/{mod}/{rate}")
+    if not lib.pc_rate_fits(cfg.rate, cfg.mod):
+        raise Error(f"rate {rate} is too fast for {mod}")
+    e = lib.pc_encoder_new(ctypes.byref(cfg))
+    if not e:
+        raise Error("encoder: out of memory")
+    try:
+        _check(lib, lib.pc_encoder_push(e, message, len(message)), "encoder")
+        _check(lib, lib.pc_encoder_start(e), "encoder")
+        n = lib.pc_encoder_length(e)
+        out = alloc(n) if alloc else (c_float * n)()
+        addr, cap = _floats(out)
+        if cap < n:
+            raise Error("encoder: alloc returned a short buffer")
+        got = lib.pc_encoder_pull(e, addr, n)
+        _check(lib, got, "encoder")
+        if got != n:
+            raise Error(f"encoder: {got} of {n} samples")
+        return out
+    finally:
+        lib.pc_encoder_free(e)
+
+def decode(samples, samplerate: int = SAMPLE_RATE, channels: int = 1, threads: int = 1,
+           stream: bool = False, decimate: bool = False) -> dict:
+    """Decode interleaved float32 frames; the result has the fields of a
+    receiver --batch --probe line ("ok", sync details, "rate", "snr_db" and
+    "advise" (None if not known), "message" bytes or "error")."""
+    lib = load()
+    addr, n = _floats(samples)
+    cfg = DecoderConfig()
+    lib.pc_decoder_defaults(ctypes.byref(cfg))
+    cfg.samplerate = samplerate
+    cfg.channels = channels
+    cfg.frames = n // channels
+    cfg.stream = int(stream)
+    cfg.threads = threads
+    cfg.decimate = int(decimate)
+    d = lib.pc_decoder_new(ctypes.byref(cfg))
+    if not d:
+        raise Error("decoder: out of memory or bad configuration")
+    try:
+        _check(lib, lib.pc_decoder_push(d, addr, n // channels), "decoder")
+        _check(lib, lib.pc_decoder_finish(d), "decoder")
+        info = Info()
+        lib.pc_decoder_info(d, ctypes.byref(info))
+        plain = ctypes.create_string_buffer(max(info.plain, 1))
+        k = lib.pc_decoder_pull(d, plain, info.plain) if info.plain > 0 else 0
+        r = {
+            "ok": bool(info.ok),
+            "sync_off": info.sync_off, "sync_inv": info.sync_inv,
+            "score": info.score, "pre_bits": info.pre_bits,
+            "pos": info.pos, "inv": info.inv,
+            "snr_db": None if info.snr_db != info.snr_db else round(info.snr_db, 1),
+            "advise": None,
+        }
+        if info.rate >= 0:
+            r["rate"] = lib.pc_rate_name(info.rate).decode()
+        if r["snr_db"] is not None:
+            a = lib.pc_rate_advise(info.snr_db, max(info.fec, 0), max(info.mod, 0))
+            r["advise"] = lib.pc_rate_name(a).decode() if a >= 0 else None
+        if info.packetized:
+            r["packets"] = info.packets
+            r["good"] = info.good
+        if info.ok:
+            r["message"] = plain.raw[:k]
+        else:
+            r["error"] = (info.error or b"").decode(errors="replace").strip()
+            if k:
+                r["partial"] = plain.raw[:k]
+        return r
+    finally:
+        lib.pc_decoder_free(d)
+
+def channel(x, samplerate: int, preset: str = "voip", noise: str = "mix", snr: float = 18.0, seed: int = 123,
+            alloc: Optional[Callable[[int], object]] = None):
+    """Tester.py's compression preset then noise on mono float32 x, in native
+    code (channel.h). Returns alloc(n) filled with the n output samples
+    (alloc defaults to a ctypes float array)."""
+    lib = load()
+    p = lib.pc_channel_preset(preset.encode())
+    k = lib.pc_channel_noise(noise.encode())
+    if p < 0 or k < 0:
+        raise Error(f"unknown preset or noise type: {preset}/{noise}")
+    addr, n = _floats(x)
+    m = lib.pc_channel_length(n, samplerate, p)
+    _check(lib, m, "channel")
+    out = alloc(m) if alloc else (c_float * max(m, 1))()
+    oaddr, cap = _floats(out)
+    if cap < m:
+        raise Error("channel: alloc returned a short buffer")
+    _check(lib, lib.pc_channel_apply(p, k, snr, seed & (2**64 - 1), addr, n, samplerate, oaddr), "channel")
+    return out
@@ -2,15 +2,34 @@
  * receiver.c - Phone-band robust BFSK receiver
  * Usage:
  *   ./receiver encoded_signal.wav
+ *   ./receiver --stream capture.wav   (bounded memory, decode as samples arrive)
+ *   arecord -f S16_LE -r 44100 -t wav - | ./receiver -
+ *   ./receiver first.wav resend.wav   (packetized: merge the good packets)
+ *   ./receiver --pipe --stream -      (packetized: plaintext is written as each
+ *                                       packet passes its CRC)
+ *   ./receiver --batch [--jobs N] a.wav b.wav dir/ ...
+ *                 decode many files in one process, one JSON line each
+ *   ./receiver --channels [--jobs N] lines.wav ...
+ *                 every channel is its own line: one JSON line per channel
+ *   --threads N   worker threads for the exhaustive preamble sweep
+ *                 (default: online CPUs)
+ *   --scalar      use the reference correlator instead of SIMD kernels
+ *   --decimate    demodulate at ~11 kHz after the band-pass (polyphase)
+ *   --hard        REP majority vote on sliced windows (default: soft sum)
+ *   --probe       estimate the link's SNR from the preamble's bin energies
+ *                 and print the fastest body rate the frame's code and
+ *                 modulation still take there (sender --rate); with
+ *                 --batch / --channels "snr_db" and "advise" in each result
+ *   --stats       decode telemetry (rxstats.h): stage times and cycles,
+ *                 correlator windows, offsets scanned, refinement steps,
+ *                 bit margins. A JSON line per input on stderr; with
+ *                 --batch / --channels a "stats" object in each result
  *
- * Steps:
- * 1) Load mono float
- * 2) DC remove + normalize
- * 3) Bandpass (rough) around 700..2600 Hz to reduce speech/music junk
- * 4) Find preamble by scanning offsets (1010...) + try invert
- * 5) Refine around boundary by searching MAGIC "STEG"
- * 6) Decode frame using REP majority vote
- * 7) CRC check then AES-CTR decrypt
+ * The receive chain (front end, sync, demodulation, channel decoding,
+ * decryption) runs in libphonocrypt (phonocrypt.h, steps in phonocrypt.c);
+ * this tool reads the captures, from the PCM16 mapping (wavmap.h) or
+ * libsndfile, pushes their frames into a decoder a block at a time and
+ * prints the results.
  */
 
 #include <stdio.h>
@@ -18,394 +37,502 @@
 #include <string.h>
 #include <stdint.h>
 #include <math.h>
-#include <openssl/evp.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <strings.h>
+#include <sys/stat.h>
 #include <sndfile.h>
+#include "phonocrypt.h"
+#include "wavmap.h"
 
-/* Must match sender */
-#define FREQ_0          1200.0
-#define FREQ_1          2200.0
-#define BIT_DURATION    0.015
-#define PREAMBLE_SECONDS 1.5
-#define REP             3
-
-/* Search params */
-#define SEARCH_SECONDS   3.0
-#define SEARCH_STEP_FRAC 6     /* step = spb/6 */
-#define REFINE_STEPS     24    /* refine +-spb with spb/REFINE_STEPS */
-
-static unsigned char key[32] = "01234567890123456789012345678901";
-static unsigned char iv[16]  = "0123456789012345";
-
-/* ---------- AES-CTR decrypt ---------- */
-static int decrypt_aes_ctr(const unsigned char *cipher, int clen,
-                           unsigned char *plain, int cap)
-{
-    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
-    if(!ctx) return -1;
-
-    int len=0, outlen=0;
-    if(EVP_DecryptInit_ex(ctx, EVP_aes_256_ctr(), NULL, key, iv) != 1) goto fail;
-    if(EVP_DecryptUpdate(ctx, plain, &len, cipher, clen) != 1) goto fail;
-    outlen = len;
-    if(EVP_DecryptFinal_ex(ctx, plain + outlen, &len) != 1) goto fail;
-    outlen += len;
-
-    EVP_CIPHER_CTX_free(ctx);
-    return (outlen <= cap) ? outlen : -1;
-
-fail:
-    EVP_CIPHER_CTX_free(ctx);
-    return -1;
-}
+#define RX_BLOCK         4096  /* frames per read */
+#define RX_RELEASE       (1LL << 20)  /* mapped frames between page releases */
+#define RX_MAX_THREADS   64
 
-/* ---------- CRC32 ---------- */
-static uint32_t crc32_table[256];
+/* decoder options from the command line; per input: rate and channels */
+static pc_decoder_config g_cfg;
+static FILE *g_pipe = NULL;      /* --pipe: packets are decrypted and written here */
+static int g_probe = 0;          /* --probe: report the SNR and the advised rate */
 
-static void crc32_init(void){
-    uint32_t poly = 0xEDB88320u;
-    for(uint32_t i=0;i<256;i++){
-        uint32_t c=i;
-        for(int k=0;k<8;k++) c = (c & 1u) ? (poly ^ (c >> 1)) : (c >> 1);
-        crc32_table[i]=c;
+/* ---------- Input ---------- */
+/* Interleaved frames of a capture, from the PCM16 mapping or libsndfile;
+ * stream: "-" is stdin and the length may be unknown */
+typedef struct {
+    wavmap wm;
+    int mapped;
+    SNDFILE *f;
+    int ch, fs;
+    long long frames, pos;   /* frames: 0 if unknown */
+    long long released;      /* mapping dropped up to here (mapped) */
+} rx_reader;
+
+static int reader_open(rx_reader *r, const char *path, int stream){
+    memset(r, 0, sizeof(*r));
+    if(strcmp(path, "-") != 0 && wavmap_open(&r->wm, path) == 0){
+        r->mapped = 1;
+        r->ch = r->wm.channels;
+        r->fs = r->wm.samplerate;
+        r->frames = r->wm.frames;
+        return 0;
     }
-}
-static uint32_t crc32_compute(const uint8_t *data, size_t n){
-    uint32_t c=0xFFFFFFFFu;
-    for(size_t i=0;i<n;i++) c = crc32_table[(c ^ data[i]) & 0xFFu] ^ (c >> 8);
-    return c ^ 0xFFFFFFFFu;
-}
-
-/* ---------- WAV load mono ---------- */
-static float *load_mono(const char *path, int *out_n, int *out_fs){
-    *out_n=0; *out_fs=0;
-
     SF_INFO info; memset(&info,0,sizeof(info));
-    SNDFILE *f = sf_open(path, SFM_READ, &info);
-    if(!f) return NULL;
-    if(info.frames<=0 || info.channels<=0){ sf_close(f); return NULL; }
-
-    *out_fs = info.samplerate;
-
-    sf_count_t frames = info.frames;
-    int ch = info.channels;
-    sf_count_t total = frames * ch;
-
-    float *tmp = (float*)malloc((size_t)total*sizeof(float));
-    if(!tmp){ sf_close(f); return NULL; }
-
-    sf_count_t r = sf_read_float(f, tmp, total);
-    sf_close(f);
-    if(r <= 0){ free(tmp); return NULL; }
-
-    float *mono = (float*)malloc((size_t)frames*sizeof(float));
-    if(!mono){ free(tmp); return NULL; }
+    r->f = sf_open(path, SFM_READ, &info);
+    if(!r->f) return -1;
+    if((!stream && info.frames<=0) || info.channels<=0){ sf_close(r->f); r->f = NULL; return -1; }
+    r->ch = info.channels;
+    r->fs = info.samplerate;
+    r->frames = (info.frames > 0 && !stream) ? info.frames : 0;
+    return 0;
+}
 
-    for(int i=0;i<(int)frames;i++){
-        double sum=0.0;
-        for(int c=0;c<ch;c++){
-            sf_count_t idx=(sf_count_t)i*ch + c;
-            if(idx < r) sum += tmp[idx];
+/* Up to k frames into blk (k * ch floats); returns frames */
+static long long reader_read(rx_reader *r, float *blk, long long k){
+    long long got;
+    if(r->mapped){
+        got = wavmap_read_frames(&r->wm, r->pos, blk, k);
+        /* a madvise per block costs more than the copy, as in cover.h */
+        if(got > 0 && r->pos + got - r->released >= RX_RELEASE){
+            r->released = r->pos + got;
+            wavmap_release(&r->wm, r->released);
         }
-        mono[i]=(float)(sum/ch);
     }
-    free(tmp);
-
-    *out_n = (int)frames;
-    return mono;
+    else got = (long long)sf_readf_float(r->f, blk, (sf_count_t)k);
+    if(got < 0) got = 0;
+    r->pos += got;
+    return got;
 }
 
-static float rmsf(const float *x, int n){
-    double s=0.0;
-    for(int i=0;i<n;i++){
-        double v=x[i];
-        s += v*v;
-    }
-    return (float)sqrt(s/(double)(n>0?n:1));
+static void reader_close(rx_reader *r){
+    if(r->f) sf_close(r->f);
+    if(r->mapped) wavmap_close(&r->wm);
+    memset(r, 0, sizeof(*r));
 }
 
-/* DC remove + normalize to fixed RMS */
-static void preprocess(float *x, int n){
-    if(n<=0) return;
-
-    /* remove DC */
-    double mean=0.0;
-    for(int i=0;i<n;i++) mean += x[i];
-    mean /= (double)n;
-    for(int i=0;i<n;i++) x[i] = (float)(x[i] - mean);
-
-    /* normalize RMS */
-    float r = rmsf(x, n);
-    if(r < 1e-6f) return;
-    float target = 0.25f;
-    float g = target / r;
-    for(int i=0;i<n;i++) x[i] *= g;
+/* --pipe: write what the decoder has released */
+static void pipe_out(pc_decoder *d, long *wrote){
+    char buf[4096];
+    long k;
+    while((k = pc_decoder_pull(d, buf, sizeof(buf))) > 0){
+        fwrite(buf, 1, (size_t)k, g_pipe);
+        *wrote += k;
+    }
+    fflush(g_pipe);
 }
 
-/* Simple biquad (RBJ) */
-typedef struct {
-    double b0,b1,b2,a1,a2;
-    double z1,z2;
-} biquad;
-
-static biquad rbj_lowpass(int fs, double f0, double Q){
-    double w0 = 2.0*M_PI*f0/(double)fs;
-    double alpha = sin(w0)/(2.0*Q);
-    double c = cos(w0);
-
-    double b0=(1-c)/2, b1=1-c, b2=(1-c)/2;
-    double a0=1+alpha, a1=-2*c, a2=1-alpha;
-
-    biquad q;
-    q.b0=b0/a0; q.b1=b1/a0; q.b2=b2/a0;
-    q.a1=a1/a0; q.a2=a2/a0;
-    q.z1=0; q.z2=0;
-    return q;
-}
+/* Decode one input with cfg (a copy: rate and channels are set here);
+ * NULL with *why set if it can't be read. With wrote set the plaintext is
+ * written to g_pipe as the decoder releases it. */
+static pc_decoder *decode_path(const char *path, pc_decoder_config cfg, long *wrote, const char **why){
+    rx_reader rd;
+    if(strcmp(path, "-") == 0) cfg.stream = 1;
+    *why = NULL;
+    if(reader_open(&rd, path, cfg.stream) != 0){
+        *why = cfg.stream ? "Failed to open wav stream\n" : "Failed to load wav\n";
+        return NULL;
+    }
+    if(rd.frames > 0x7FFFFFFFLL && !cfg.stream){
+        reader_close(&rd);
+        *why = "Failed to load wav\n";
+        return NULL;
+    }
 
-static biquad rbj_highpass(int fs, double f0, double Q){
-    double w0 = 2.0*M_PI*f0/(double)fs;
-    double alpha = sin(w0)/(2.0*Q);
-    double c = cos(w0);
+    cfg.samplerate = rd.fs;
+    cfg.channels = rd.ch;
+    cfg.frames = rd.frames;
+    cfg.progressive = wrote != NULL;
+    pc_decoder *d = pc_decoder_new(&cfg);
+    float *blk = (float*)malloc((size_t)RX_BLOCK*(size_t)rd.ch*sizeof(float));
+    if(!d || !blk){
+        free(blk);
+        pc_decoder_free(d);
+        reader_close(&rd);
+        *why = "Out of memory (decoder)\n";
+        return NULL;
+    }
 
-    double b0=(1+c)/2, b1=-(1+c), b2=(1+c)/2;
-    double a0=1+alpha, a1=-2*c, a2=1-alpha;
+    long long k;
+    while((k = reader_read(&rd, blk, RX_BLOCK)) > 0){
+        if(pc_decoder_push(d, blk, k) != PC_OK) break;
+        if(wrote) pipe_out(d, wrote);
+    }
+    pc_decoder_finish(d);
+    if(wrote) pipe_out(d, wrote);
 
-    biquad q;
-    q.b0=b0/a0; q.b1=b1/a0; q.b2=b2/a0;
-    q.a1=a1/a0; q.a2=a2/a0;
-    q.z1=0; q.z2=0;
-    return q;
+    free(blk);
+    reader_close(&rd);
+    return d;
 }
 
-static void biquad_process(biquad *q, float *x, int n){
-    double z1=q->z1, z2=q->z2;
-    for(int i=0;i<n;i++){
-        double in=x[i];
-        double out = q->b0*in + z1;
-        z1 = q->b1*in - q->a1*out + z2;
-        z2 = q->b2*in - q->a2*out;
-        x[i] = (float)out;
+/* ---------- Results ---------- */
+static void json_str(FILE *o, const char *v){
+    fputc('"', o);
+    for(const unsigned char *p=(const unsigned char*)v; *p; p++){
+        if(*p == '"' || *p == '\\') fprintf(o, "\\%c", *p);
+        else if(*p == '\n') fputs("\\n", o);
+        else if(*p < 0x20) fprintf(o, "\\u%04x", *p);
+        else fputc(*p, o);
     }
-    q->z1=z1; q->z2=z2;
-}
-
-/* Bandpass around 700..2600 Hz (helps phone-band BFSK) */
-static void bandpass(float *x, int n, int fs){
-    biquad hp = rbj_highpass(fs, 700.0, 0.707);
-    biquad lp = rbj_lowpass(fs, 2600.0, 0.707);
-    biquad_process(&hp, x, n);
-    biquad_process(&lp, x, n);
+    fputc('"', o);
 }
 
-/* I/Q energy compare, phase-robust */
-static int detect_bit_q(const float *x, long long start, int len, int fs, int invert){
-    double i0=0,q0=0,i1=0,q1=0;
-    double w0=2.0*M_PI*FREQ_0/(double)fs;
-    double w1=2.0*M_PI*FREQ_1/(double)fs;
-
-    for(int n=0;n<len;n++){
-        double s = x[start + n];
-
-        i0 += s * cos(w0*n);  q0 += s * sin(w0*n);
-        i1 += s * cos(w1*n);  q1 += s * sin(w1*n);
+/* Result of d, or of an input that could not be read (d NULL, why) */
+static void get_info(pc_decoder *d, const char *why, pc_info *in){
+    static const rx_stats none;
+    if(d){
+        pc_decoder_info(d, in);
+        return;
     }
-
-    double p0=i0*i0+q0*q0;
-    double p1=i1*i1+q1*q1;
-
-    int bit = (p1 > p0) ? 1 : 0;
-    if(invert) bit ^= 1;
-    return bit;
+    memset(in, 0, sizeof(*in));
+    in->sync_off = -1;
+    in->score = -1;
+    in->pos = -1;
+    in->fec = in->mod = in->rate = -1;
+    in->snr_db = NAN;
+    in->error = why;
+    in->stats = g_cfg.stats ? &none : NULL;
 }
 
-static int decode_coded_bit(const float *x, long long pos, int spb, int fs, int invert){
-    int ones=0;
-    for(int r=0;r<REP;r++){
-        int b = detect_bit_q(x, pos + (long long)r*spb, spb, fs, invert);
-        ones += b;
-    }
-    return (ones > (REP/2)) ? 1 : 0;
+/* The plaintext d holds, NUL-terminated (malloc'd; NULL if none) */
+static char *get_plain(pc_decoder *d, const pc_info *in){
+    if(!d || in->plain <= 0) return NULL;
+    char *p = (char*)malloc((size_t)in->plain + 1);
+    if(!p) return NULL;
+    long k = pc_decoder_pull(d, p, in->plain);
+    p[k > 0 ? k : 0] = 0;
+    return p;
 }
 
-static uint8_t decode_byte(const float *x, long long *pos, int spb, int fs, int invert){
-    uint8_t v=0;
-    for(int k=0;k<8;k++){
-        int b = decode_coded_bit(x, *pos, spb, fs, invert);
-        v = (uint8_t)((v<<1) | (uint8_t)(b & 1));
-        *pos += (long long)REP * (long long)spb;
-    }
-    return v;
+/* --probe: the advice is for the frame's own code and modulation (conv /
+ * bfsk if its header was not read); -1 if even 15 ms is not safe */
+static int probe_advise(const pc_info *in, int *fec, int *mod){
+    *fec = (in->fec >= 0) ? in->fec : PC_FEC_CONV;
+    *mod = (in->mod >= 0) ? in->mod : PC_MOD_BFSK;
+    return pc_rate_advise(in->snr_db, *fec, *mod);
 }
 
-/* score preamble match at offset */
-static int score_preamble(const float *x, int n, long long off, int spb, int fs, int pre_bits, int invert){
-    int score=0;
-    for(int b=0;b<pre_bits;b++){
-        long long pos = off + (long long)b*spb;
-        if(pos + spb >= n) break;
-        int expected = (b & 1) ? 1 : 0; /* 1010... */
-        int got = detect_bit_q(x, pos, spb, fs, invert);
-        if(got == expected) score++;
-    }
-    return score;
+static void print_probe(FILE *o, const pc_info *in){
+    if(isnan(in->snr_db)){ fprintf(o, "Probe: no frame found\n"); return; }
+    int fec, mod, r = probe_advise(in, &fec, &mod);
+    fprintf(o, "Probe: SNR %.1f dB (preamble, 15 ms bins)", in->snr_db);
+    if(in->rate >= 0) fprintf(o, ", frame sent at %s", pc_rate_name(in->rate));
+    if(r < 0) fprintf(o, "\nProbe: too noisy for %s/%s even at 15ms\n", pc_fec_name(fec), pc_mod_name(mod));
+    else fprintf(o, "\nProbe: fastest safe rate for %s/%s: %s (sender --rate %s)\n",
+                 pc_fec_name(fec), pc_mod_name(mod), pc_rate_name(r), pc_rate_name(r));
 }
 
-int main(int argc, char **argv){
-    if(argc < 2){
-        fprintf(stderr, "Usage: %s <file.wav>\n", argv[0]);
-        return 1;
+/* one JSON object per line; chan >= 0 names the channel (--channels).
+ * Returns 1 if the input decoded. */
+static int print_result_json(FILE *o, const char *path, int chan, pc_decoder *d, const char *why){
+    pc_info in;
+    get_info(d, why, &in);
+    char *plain = get_plain(d, &in);
+
+    fputs("{\"file\":", o);
+    json_str(o, path);
+    if(chan >= 0) fprintf(o, ",\"channel\":%d", chan);
+    fprintf(o, ",\"ok\":%s,\"sync_off\":%lld,\"sync_inv\":%d,\"score\":%d,\"pre_bits\":%d,\"pos\":%lld,\"inv\":%d",
+            in.ok ? "true" : "false", in.sync_off, in.sync_inv, in.score, in.pre_bits, in.pos, in.inv);
+    if(in.packetized) fprintf(o, ",\"packets\":%d,\"good\":%d", in.packets, in.good);
+    if(in.ok){
+        fprintf(o, ",\"fec\":\"%s\",\"mod\":\"%s\",\"rate\":\"%s\",\"len\":%ld,\"message\":",
+                pc_fec_name(in.fec), pc_mod_name(in.mod), pc_rate_name(in.rate), in.len);
+        json_str(o, plain ? plain : "");
+    } else {
+        if(plain){
+            fputs(",\"partial\":", o);
+            json_str(o, plain);
+        }
+        char *e = strdup(in.error ? in.error : "");
+        size_t k = e ? strlen(e) : 0;
+        while(k > 0 && e[k-1] == '\n') e[--k] = 0;
+        fputs(",\"error\":", o);
+        json_str(o, e ? e : "");
+        free(e);
     }
-
-    crc32_init();
-
-    int n=0, fs=0;
-    float *x = load_mono(argv[1], &n, &fs);
-    if(!x){
-        fprintf(stderr, "Failed to load wav\n");
-        return 1;
+    if(g_probe){
+        int fec, mod, r = probe_advise(&in, &fec, &mod);
+        if(isnan(in.snr_db)) fputs(",\"snr_db\":null,\"advise\":null", o);
+        else if(r < 0) fprintf(o, ",\"snr_db\":%.1f,\"advise\":null", in.snr_db);
+        else fprintf(o, ",\"snr_db\":%.1f,\"advise\":\"%s\"", in.snr_db, pc_rate_name(r));
     }
-
-    preprocess(x, n);
-    bandpass(x, n, fs);
-
-    int spb = (int)lround((double)fs * (double)BIT_DURATION);
-    if(spb < 40){
-        fprintf(stderr, "BIT_DURATION too small or fs weird\n");
-        free(x);
-        return 1;
+    if(in.stats){
+        fputs(",\"stats\":", o);
+        rx_stats_json(o, in.stats);
     }
+    fputs("}\n", o);
+    free(plain);
+    return in.ok;
+}
 
-    int pre_bits = (int)lround(PREAMBLE_SECONDS / BIT_DURATION);
-    if(pre_bits < 32) pre_bits = 32;
-
-    long long search_max = (long long)lround(SEARCH_SECONDS * (double)fs);
-    if(search_max > n) search_max = n;
-
-    long long step = spb / SEARCH_STEP_FRAC;
-    if(step < 1) step = 1;
-
-    long long best_off=-1;
-    int best_inv=0;
-    int best_score=-1;
-
-    for(long long off=0; off + (long long)pre_bits*spb < search_max; off += step){
-        int s0 = score_preamble(x, n, off, spb, fs, pre_bits, 0);
-        if(s0 > best_score){ best_score=s0; best_off=off; best_inv=0; }
-
-        int s1 = score_preamble(x, n, off, spb, fs, pre_bits, 1);
-        if(s1 > best_score){ best_score=s1; best_off=off; best_inv=1; }
-
-        if(best_score > (int)(0.93 * pre_bits)) break;
-    }
+/* --stats in single-file mode: one line per input on stderr */
+static void print_stats_json(FILE *o, const char *path, pc_decoder *d){
+    pc_info in;
+    get_info(d, NULL, &in);
+    fputs("{\"file\":", o);
+    json_str(o, path);
+    fputs(",\"stats\":", o);
+    rx_stats_json(o, in.stats);
+    fputs("}\n", o);
+}
 
-    if(best_off < 0){
-        fprintf(stderr, "Sync not found\n");
-        free(x);
-        return 1;
+/* ---------- Batch mode ---------- */
+typedef struct {
+    char **paths;
+    int count;
+    pc_decoder_config cfg;
+    pc_decoder **dec;
+    const char **why;
+    uint8_t *done;
+    int next_print, failed;
+    atomic_int next;
+    pthread_mutex_t lock;
+} batch_ctx;
+
+static void *batch_worker(void *arg){
+    batch_ctx *b = (batch_ctx*)arg;
+
+    for(;;){
+        int i = atomic_fetch_add(&b->next, 1);
+        if(i >= b->count) break;
+        b->dec[i] = decode_path(b->paths[i], b->cfg, NULL, &b->why[i]);
+
+        /* results go out in input order as soon as they are complete */
+        pthread_mutex_lock(&b->lock);
+        b->done[i] = 1;
+        while(b->next_print < b->count && b->done[b->next_print]){
+            int k = b->next_print++;
+            if(!print_result_json(stdout, b->paths[k], -1, b->dec[k], b->why[k])) b->failed = 1;
+            pc_decoder_free(b->dec[k]);
+            b->dec[k] = NULL;
+        }
+        fflush(stdout);
+        pthread_mutex_unlock(&b->lock);
     }
+    return NULL;
+}
 
-    /* refine around boundary by scanning for MAGIC "STEG" */
-    long long base = best_off + (long long)pre_bits * (long long)spb;
-
-    long long best_pos = -1;
-    int best_inv2 = best_inv;
-
-    long long step2 = spb / REFINE_STEPS;
-    if(step2 < 1) step2 = 1;
-
-    for(long long delta = -spb; delta <= spb; delta += step2){
-        for(int inv_try=0; inv_try<=1; inv_try++){
-            long long p = base + delta;
-            if(p < 0) continue;
-            if(p + (long long)4 * (long long)REP * (long long)spb * 8LL >= n) continue;
+static int has_wav_suffix(const char *name){
+    size_t k = strlen(name);
+    return k > 4 && strcasecmp(name + k - 4, ".wav") == 0;
+}
 
-            long long tmp = p;
-            unsigned char m0 = decode_byte(x, &tmp, spb, fs, inv_try);
-            unsigned char m1 = decode_byte(x, &tmp, spb, fs, inv_try);
-            unsigned char m2 = decode_byte(x, &tmp, spb, fs, inv_try);
-            unsigned char m3 = decode_byte(x, &tmp, spb, fs, inv_try);
+static int cmp_str(const void *a, const void *b){
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
 
-            if(m0=='S' && m1=='T' && m2=='E' && m3=='G'){
-                best_pos = p;
-                best_inv2 = inv_try;
-                goto FOUND;
+/* Expand args into a path list: directories contribute their *.wav files
+ * (sorted), anything else is taken as a file. Returns count, -1 on OOM. */
+static int collect_paths(char **args, int nargs, char ***out){
+    int cap = 64, cnt = 0;
+    char **v = (char**)malloc((size_t)cap*sizeof(char*));
+    if(!v) return -1;
+
+    for(int a=0;a<nargs;a++){
+        struct stat st;
+        DIR *dir = (stat(args[a], &st) == 0 && S_ISDIR(st.st_mode)) ? opendir(args[a]) : NULL;
+        int first = cnt;
+        struct dirent *de = NULL;
+
+        while(dir ? (de = readdir(dir)) != NULL : cnt == first){
+            if(dir && !has_wav_suffix(de->d_name)) continue;
+            if(cnt == cap){
+                char **nv = (char**)realloc(v, (size_t)(cap*2)*sizeof(char*));
+                if(!nv){ if(dir) closedir(dir); goto oom; }
+                v = nv; cap *= 2;
+            }
+            if(dir){
+                size_t len = strlen(args[a]) + strlen(de->d_name) + 2;
+                v[cnt] = (char*)malloc(len);
+                if(!v[cnt]){ closedir(dir); goto oom; }
+                snprintf(v[cnt], len, "%s/%s", args[a], de->d_name);
+            } else {
+                v[cnt] = strdup(args[a]);
+                if(!v[cnt]) goto oom;
             }
+            cnt++;
         }
-    }
 
-FOUND:
-    if(best_pos < 0){
-        fprintf(stderr, "MAGIC not found near sync. score=%d/%d\n", best_score, pre_bits);
-        free(x);
-        return 1;
+        if(dir){
+            closedir(dir);
+            qsort(v + first, (size_t)(cnt - first), sizeof(char*), cmp_str);
+        }
     }
 
-    long long pos = best_pos;
-    int invert = best_inv2;
-
-    /* decode header: MAGIC+LEN */
-    unsigned char hdr[8];
-    for(int i=0;i<8;i++) hdr[i] = decode_byte(x, &pos, spb, fs, invert);
+    *out = v;
+    return cnt;
 
-    if(!(hdr[0]=='S' && hdr[1]=='T' && hdr[2]=='E' && hdr[3]=='G')){
-        fprintf(stderr, "MAGIC mismatch (should not happen after refine)\n");
-        fprintf(stderr, "Got: %02X %02X %02X %02X\n", hdr[0],hdr[1],hdr[2],hdr[3]);
-        free(x);
-        return 1;
-    }
+oom:
+    for(int i=0;i<cnt;i++) free(v[i]);
+    free(v);
+    return -1;
+}
 
-    uint32_t clen = ((uint32_t)hdr[4]<<24) | ((uint32_t)hdr[5]<<16) | ((uint32_t)hdr[6]<<8) | (uint32_t)hdr[7];
-    if(clen == 0 || clen > 2000000u){
-        fprintf(stderr, "Invalid LEN: %u\n", clen);
-        free(x);
-        return 1;
+/* Decode every input on a pool of jobs workers; one JSON line per file.
+ * Returns 0 if all files decoded. */
+static int run_batch(char **args, int nargs, int jobs){
+    char **paths = NULL;
+    int count = collect_paths(args, nargs, &paths);
+    if(count < 0){ fprintf(stderr, "Out of memory (batch list)\n"); return 1; }
+
+    batch_ctx b;
+    memset(&b, 0, sizeof(b));
+    b.paths = paths;
+    b.count = count;
+    if(jobs > count) jobs = count;
+    if(jobs > RX_MAX_THREADS) jobs = RX_MAX_THREADS;
+    if(jobs < 1) jobs = 1;
+    /* cores not used by the workers go to each file's offset sweep */
+    b.cfg = g_cfg;
+    b.cfg.threads = (g_cfg.threads / jobs > 1) ? g_cfg.threads / jobs : 1;
+
+    b.dec = (pc_decoder**)calloc((size_t)(count > 0 ? count : 1), sizeof(pc_decoder*));
+    b.why = (const char**)calloc((size_t)(count > 0 ? count : 1), sizeof(char*));
+    b.done = (uint8_t*)calloc((size_t)(count > 0 ? count : 1), 1);
+    atomic_init(&b.next, 0);
+    pthread_mutex_init(&b.lock, NULL);
+
+    int rc = 0;
+    if(!b.dec || !b.why || !b.done){
+        fprintf(stderr, "Out of memory (batch results)\n");
+        rc = 1;
+    } else {
+        pthread_t tid[RX_MAX_THREADS];
+        int started = 0;
+        for(int t=1;t<jobs;t++){
+            if(pthread_create(&tid[started], NULL, batch_worker, &b) != 0) break;
+            started++;
+        }
+        batch_worker(&b);
+        for(int t=0;t<started;t++) pthread_join(tid[t], NULL);
+        rc = b.failed;
     }
 
-    size_t frame_no_crc = 8 + (size_t)clen;
-    unsigned char *frame = (unsigned char*)malloc(frame_no_crc + 4);
-    if(!frame){ free(x); return 1; }
-    memcpy(frame, hdr, 8);
+    pthread_mutex_destroy(&b.lock);
+    free(b.done);
+    free(b.why);
+    free(b.dec);
+    for(int i=0;i<count;i++) free(paths[i]);
+    free(paths);
+    return rc;
+}
 
-    for(uint32_t i=0;i<clen;i++){
-        frame[8+i] = decode_byte(x, &pos, spb, fs, invert);
+/* --channels: the channels of each capture are decoded as separate lines
+ * (a split decoder: its workers take the lines), one JSON line per
+ * channel (with "channel"); files are taken one after another, so one
+ * capture's planes are in memory at a time. Returns 0 if every channel of
+ * every file decoded. */
+static int run_channels(char **args, int nargs, int jobs){
+    char **paths = NULL;
+    int count = collect_paths(args, nargs, &paths);
+    if(count < 0){ fprintf(stderr, "Out of memory (batch list)\n"); return 1; }
+
+    pc_decoder_config cfg = g_cfg;
+    cfg.split = 1;
+    cfg.jobs = jobs;
+    int rc = 0;
+    for(int f=0;f<count;f++){
+        const char *why;
+        pc_decoder *d = decode_path(paths[f], cfg, NULL, &why);
+        int lines = d ? pc_decoder_lines(d) : 0;
+        if(lines == 0 && !print_result_json(stdout, paths[f], -1, d, why)) rc = 1;
+        for(int c=0;c<lines;c++)
+            if(!print_result_json(stdout, paths[f], c, pc_decoder_line(d, c), NULL)) rc = 1;
+        fflush(stdout);
+        pc_decoder_free(d);
     }
 
-    unsigned char crc_bytes[4];
-    for(int i=0;i<4;i++) crc_bytes[i] = decode_byte(x, &pos, spb, fs, invert);
-
-    uint32_t crc_stored = ((uint32_t)crc_bytes[0]<<24) | ((uint32_t)crc_bytes[1]<<16) | ((uint32_t)crc_bytes[2]<<8) | (uint32_t)crc_bytes[3];
-    uint32_t crc_calc = crc32_compute(frame, frame_no_crc);
+    for(int i=0;i<count;i++) free(paths[i]);
+    free(paths);
+    return rc;
+}
 
-    if(crc_calc != crc_stored){
-        fprintf(stderr, "CRC mismatch (data corrupted)\n");
-        fprintf(stderr, "calc=%08X stored=%08X\n", crc_calc, crc_stored);
-        fprintf(stderr, "Sync: off=%lld inv=%d score=%d/%d\n", best_off, best_inv, best_score, pre_bits);
-        free(frame);
-        free(x);
+int main(int argc, char **argv){
+    int batch = 0, chans = 0;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    pc_decoder_defaults(&g_cfg);
+    g_cfg.threads = (ncpu > 0) ? (int)ncpu : 1;
+    int jobs = g_cfg.threads;
+
+    char **paths = (char**)malloc((size_t)argc*sizeof(char*));
+    int npaths = 0;
+    if(!paths) return 1;
+
+    for(int i=1;i<argc;i++){
+        if(strcmp(argv[i], "--stream") == 0) g_cfg.stream = 1;
+        else if(strcmp(argv[i], "--batch") == 0) batch = 1;
+        else if(strcmp(argv[i], "--channels") == 0) chans = 1;
+        else if(strcmp(argv[i], "--threads") == 0 && i+1 < argc) g_cfg.threads = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--jobs") == 0 && i+1 < argc) jobs = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--scalar") == 0) g_cfg.scalar = 1;
+        else if(strcmp(argv[i], "--decimate") == 0) g_cfg.decimate = 1;
+        else if(strcmp(argv[i], "--hard") == 0) g_cfg.hard = 1;
+        else if(strcmp(argv[i], "--pipe") == 0) g_pipe = stdout;
+        else if(strcmp(argv[i], "--stats") == 0) g_cfg.stats = 1;
+        else if(strcmp(argv[i], "--probe") == 0) g_probe = 1;
+        else paths[npaths++] = argv[i];
+    }
+    if(g_cfg.threads < 1) g_cfg.threads = 1;
+#ifdef RX_NO_STATS
+    if(g_cfg.stats){ fprintf(stderr, "--stats: built with RX_NO_STATS\n"); free(paths); return 1; }
+#endif
+
+    if(npaths == 0 || (g_pipe && (batch || chans || npaths != 1)) || (chans && g_cfg.stream)){
+        fprintf(stderr, "Usage: %s [--stream] [--threads N] [--scalar] [--decimate] [--hard] [--stats] [--probe] <file.wav | -> [resend.wav...]\n", argv[0]);
+        fprintf(stderr, "       %s --pipe [--stream] [options] <file.wav | ->\n", argv[0]);
+        fprintf(stderr, "       %s --batch [--jobs N] [--stream] <file.wav | dir>...\n", argv[0]);
+        fprintf(stderr, "       %s --channels [--jobs N] <file.wav | dir>...\n", argv[0]);
+        free(paths);
         return 1;
     }
 
-    /* decrypt ciphertext (frame+8 .. frame+8+clen-1) */
-    unsigned char *plain = (unsigned char*)malloc((size_t)clen + 64);
-    if(!plain){ free(frame); free(x); return 1; }
+    int rc;
+    if(chans){
+        rc = run_channels(paths, npaths, jobs);
+    } else if(batch){
+        rc = run_batch(paths, npaths, jobs);
+    } else {
+        const char *why, *why_more;
+        long wrote = 0;
+        pc_decoder *d = decode_path(paths[0], g_cfg, g_pipe ? &wrote : NULL, &why);
+        if(g_cfg.stats) print_stats_json(stderr, paths[0], d);
+        for(int i=1;i<npaths;i++){
+            pc_decoder *more = decode_path(paths[i], g_cfg, NULL, &why_more);
+            if(g_cfg.stats) print_stats_json(stderr, paths[i], more);
+            if(d && more) pc_decoder_merge(d, more, paths[i]);
+            else if(more){
+                /* the first input could not be read: a decoded resend stands in */
+                pc_info mi;
+                pc_decoder_info(more, &mi);
+                if(mi.ok || (mi.packetized && mi.good > 0)){ d = more; more = NULL; why = NULL; }
+            }
+            pc_decoder_free(more);
+        }
 
-    int plen = decrypt_aes_ctr(frame+8, (int)clen, plain, (int)clen + 64);
-    if(plen < 0){
-        fprintf(stderr, "Decrypt failed\n");
+        pc_info in;
+        get_info(d, why, &in);
+        char *plain = g_pipe ? NULL : get_plain(d, &in);
+        if(g_pipe){
+            /* packets went out as they were decoded; a single-block frame
+             * can only be released once its CRC is known */
+            if(wrote > 0) fputc('\n', stdout);
+            fputs(in.error, stderr);
+        } else if(in.ok){
+            printf("Sync: off=%lld samples (inv=%d score=%d/%d)\n", in.sync_off, in.sync_inv, in.score, in.pre_bits);
+            printf("Refined pos=%lld samples (inv=%d)\n", in.pos, in.inv);
+            printf("Decrypted Message:\n%s\n", plain ? plain : "");
+        } else {
+            fputs(in.error, stderr);
+            if(plain) printf("Partial Message (%d of %d packets):\n%s\n", in.good, in.packets, plain);
+        }
+        if(g_probe) print_probe(g_pipe ? stderr : stdout, &in);
+        rc = !in.ok;
         free(plain);
-        free(frame);
-        free(x);
-        return 1;
+        pc_decoder_free(d);
     }
-    plain[plen] = 0;
-
-
-    printf("Sync: off=%lld samples (inv=%d score=%d/%d)\n", best_off, best_inv, best_score, pre_bits);
-    printf("Refined pos=%lld samples (inv=%d)\n", best_pos, invert);
-    printf("Decrypted Message:\n%s\n", plain);
 
-    free(plain);
-    free(frame);
-    free(x);
-    return 0;
+    pc_cleanup();
+    free(paths);
+    return rc;
 }
@@ -0,0 +1,94 @@
+/*
+ * resample.h - polyphase rational resampler shared by sender and receiver
+ *
+ * fs_out = fs_in * L / M. Blackman-windowed sinc prototype at fs_in*L with
+ * its cutoff given in Hz, split into L phases of RS_TAPS taps (stored
+ * reversed so each output is one contiguous dot product). Output k sits
+ * at input time (k*M - (L*RS_TAPS-1)/2) / L. History and phase carry
+ * across blocks; copying a resampler copies its state, h is shared.
+ * The receiver decimates with it (--decimate), the sender converts cover
+ * audio to its own rate.
+ */
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define RS_TAPS        64      /* taps per polyphase branch (multiple of 8) */
+
+typedef struct {
+    int L, M;
+    const float *h;              /* L x RS_TAPS */
+    float hist[RS_TAPS];         /* last RS_TAPS-1 inputs */
+    long long next;              /* input index of next output, this block */
+    int phase;
+} resampler;
+
+/* Prototype for L phases at fs_in, low-pass at cutoff Hz, unity gain */
+static inline float *resampler_design(int L, double fs_in, double cutoff){
+    int N = L * RS_TAPS;
+    float *h = (float*)malloc((size_t)N*sizeof(float));
+    if(!h) return NULL;
+
+    double fc = cutoff / (fs_in * (double)L);   /* cycles per prototype sample */
+    double c = 0.5 * (double)(N - 1);
+    for(int m=0;m<N;m++){
+        double t = (double)m - c;
+        double sinc = (fabs(t) < 1e-9) ? 2.0*fc : sin(2.0*M_PI*fc*t) / (M_PI*t);
+        double win = 0.42 - 0.5*cos(2.0*M_PI*m/(N-1)) + 0.08*cos(4.0*M_PI*m/(N-1));
+        int p = m % L, j = m / L;
+        h[p*RS_TAPS + (RS_TAPS-1-j)] = (float)(sinc * win * (double)L);
+    }
+    return h;
+}
+
+/* Most inputs the next block may have for at most room outputs */
+static inline long long resample_fit(const resampler *r, long long room){
+    return r->next + ((long long)r->phase + room * r->M) / r->L;
+}
+
+/* Resample x[0..n); the caller guarantees n <= resample_fit(cap).
+ * Returns outputs. */
+static inline long long resample_run(resampler *r, const float *x, long long n, float *out, long long cap){
+    const int T = RS_TAPS;
+    long long k = 0;
+
+    while(r->next < n && k < cap){
+        const float *h = r->h + (size_t)r->phase * T;
+        long long first = r->next - (T-1);
+        double acc = 0.0;
+
+        if(first >= 0){
+            /* 8 independent float partial sums: vectorizes without -ffast-math */
+            const float *w = x + first;
+            float part[8] = {0};
+            for(int t=0;t<T;t+=8)
+                for(int l=0;l<8;l++) part[l] += h[t+l] * w[t+l];
+            for(int l=0;l<8;l++) acc += part[l];
+        } else {
+            for(int t=0;t<T;t++){
+                long long q = first + t;
+                acc += (double)h[t] * (double)((q >= 0) ? x[q] : r->hist[T-1+q]);
+            }
+        }
+        out[k++] = (float)acc;
+
+        r->phase += r->M;
+        r->next += r->phase / r->L;
+        r->phase %= r->L;
+    }
+
+    /* keep the last T-1 inputs (with older history if n is short) */
+    if(n >= T-1){
+        memcpy(r->hist, x + n - (T-1), (size_t)(T-1)*sizeof(float));
+    } else if(n > 0){
+        memmove(r->hist, r->hist + n, (size_t)(T-1-n)*sizeof(float));
+        memcpy(r->hist + (T-1-n), x, (size_t)n*sizeof(float));
+    }
+    r->next -= n;
+    return k;
+}
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ * rxstats.h - receiver decode telemetry (receiver --stats)
+ *
+ * One rx_stats per decoded input. Stage time is exclusive: the clock runs
+ * for exactly one stage at a time, rx_stats_switch() charges the time since
+ * the last switch to the stage that was running, so nested work (a stream
+ * read while demodulating) is charged to itself and the stages sum to the
+ * total. Wall time is in ns; cycles come from the CPU's counter where there
+ * is one (TSC on x86, CNTVCT on ARMv8, which ticks at a fixed rate, not per
+ * core cycle), 0 elsewhere. Counters are plain sums (sweep_threads is a
+ * maximum); the decoder gives each sweep thread its own rx_stats and adds
+ * it in with rx_stats_merge(). The clock only runs inside decoder calls
+ * (libphonocrypt).
+ */
+#ifndef RXSTATS_H
+#define RXSTATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+enum {
+    RXS_OTHER,      /* not attributed: setup, header parsing, CRCs */
+    RXS_LOAD,       /* taking in and downmixing the input */
+    RXS_FRONTEND,   /* DC/RMS pass, band-pass */
+    RXS_DECIMATE,   /* --decimate resampler */
+    RXS_SEARCH,     /* envelope regions and their coarse scans */
+    RXS_SWEEP,      /* exhaustive fallback sweep */
+    RXS_REFINE,     /* preamble/MAGIC boundary and MAGIC search */
+    RXS_DEMOD,      /* header bits and body symbol LLRs */
+    RXS_FEC,        /* channel decoder */
+    RXS_DECRYPT,
+    RXS_COUNT
+};
+
+static const char *const rx_stage_names[RXS_COUNT] = {
+    "other", "load", "frontend", "decimate", "search", "sweep", "refine", "demod", "fec", "decrypt"
+};
+
+#define RXS_MARGIN_BINS 10     /* margin histogram over [0,1] */
+
+typedef struct {
+    uint64_t ns[RXS_COUNT];
+    uint64_t cycles[RXS_COUNT];
+    int cur;                   /* stage the clock is running for */
+    uint64_t t_ns, t_cyc;      /* time of the last switch */
+
+    uint64_t sync_passes;      /* acquisitions run (stream mode: one per hunt window) */
+    uint64_t regions;          /* envelope regions found */
+    uint64_t candidates;       /* coarse candidates handed to refinement */
+    uint64_t sweeps;           /* exhaustive sweeps run */
+    uint64_t sweep_threads;    /* most threads a sweep ran on */
+    uint64_t offsets;          /* offsets scored by the coarse scans and sweeps */
+    uint64_t probe_dropped;    /* of those, dropped after the PRE_PROBE check */
+    uint64_t sdft;             /* sliding-DFT positions computed */
+    uint64_t windows;          /* direct correlator windows (bin_power) */
+    uint64_t refine_calls;     /* candidates refined */
+    uint64_t refine_steps;     /* MAGIC positions tried */
+    uint64_t magic_hits;       /* of those, decoding MAGIC */
+    uint64_t symbols;          /* body symbols demodulated */
+
+    /* per-bit energy margin |p1-p0|/(p1+p0) of the frame (header bits:
+     * mean over their REP windows; body: per coded bit) */
+    uint64_t margin_bits;
+    double margin_sum, margin_min;
+    uint64_t margin_hist[RXS_MARGIN_BINS];
+} rx_stats;
+
+static inline uint64_t rx_stats_cycles(void){
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    return (uint64_t)__rdtsc();
+#elif defined(__GNUC__) && defined(__aarch64__)
+    uint64_t v;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(v));
+    return v;
+#else
+    return 0;
+#endif
+}
+
+static inline uint64_t rx_stats_now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Clear s and start the clock for RXS_OTHER */
+static inline void rx_stats_start(rx_stats *s){
+    memset(s, 0, sizeof(*s));
+    s->margin_min = 1.0;
+    s->t_ns = rx_stats_now();
+    s->t_cyc = rx_stats_cycles();
+}
+
+/* Restart the clock for RXS_OTHER without charging the time since the
+ * last switch (time spent outside the decoder) */
+static inline void rx_stats_resume(rx_stats *s){
+    s->cur = RXS_OTHER;
+    s->t_ns = rx_stats_now();
+    s->t_cyc = rx_stats_cycles();
+}
+
+/* Charge the time since the last switch, run the clock for stage; returns
+ * the stage that was running */
+static inline int rx_stats_switch(rx_stats *s, int stage){
+    uint64_t t = rx_stats_now(), c = rx_stats_cycles();
+    int prev = s->cur;
+    s->ns[prev] += t - s->t_ns;
+    s->cycles[prev] += c - s->t_cyc;
+    s->t_ns = t;
+    s->t_cyc = c;
+    s->cur = stage;
+    return prev;
+}
+
+static inline void rx_stats_margin(rx_stats *s, double v){
+    if(v < 0.0) v = -v;
+    if(v > 1.0) v = 1.0;
+    int bin = (int)(v * RXS_MARGIN_BINS);
+    if(bin == RXS_MARGIN_BINS) bin--;
+    s->margin_hist[bin]++;
+    s->margin_bits++;
+    s->margin_sum += v;
+    if(v < s->margin_min) s->margin_min = v;
+}
+
+/* Counters and margins of o into s (stage times stay with their thread) */
+static inline void rx_stats_merge(rx_stats *s, const rx_stats *o){
+    s->sync_passes += o->sync_passes;     s->regions += o->regions;
+    s->candidates += o->candidates;       s->sweeps += o->sweeps;
+    if(o->sweep_threads > s->sweep_threads) s->sweep_threads = o->sweep_threads;
+    s->offsets += o->offsets;             s->probe_dropped += o->probe_dropped;
+    s->sdft += o->sdft;                   s->windows += o->windows;
+    s->refine_calls += o->refine_calls;   s->refine_steps += o->refine_steps;
+    s->magic_hits += o->magic_hits;       s->symbols += o->symbols;
+    for(int i=0;i<RXS_MARGIN_BINS;i++) s->margin_hist[i] += o->margin_hist[i];
+    s->margin_bits += o->margin_bits;
+    s->margin_sum += o->margin_sum;
+    if(o->margin_bits && o->margin_min < s->margin_min) s->margin_min = o->margin_min;
+}
+
+/* One JSON object, no newline */
+static inline void rx_stats_json(FILE *o, const rx_stats *s){
+    uint64_t total = 0;
+    for(int i=0;i<RXS_COUNT;i++) total += s->ns[i];
+    fprintf(o, "{\"ns\":%llu,\"stages\":{", (unsigned long long)total);
+    for(int i=0;i<RXS_COUNT;i++)
+        fprintf(o, "%s\"%s\":{\"ns\":%llu,\"cycles\":%llu}", i ? "," : "", rx_stage_names[i],
+                (unsigned long long)s->ns[i], (unsigned long long)s->cycles[i]);
+    fprintf(o, "},\"sync_passes\":%llu,\"regions\":%llu,\"candidates\":%llu,\"sweeps\":%llu"
+               ",\"sweep_threads\":%llu,\"offsets\":%llu,\"probe_dropped\":%llu,\"sdft\":%llu,\"windows\":%llu"
+               ",\"refine_calls\":%llu,\"refine_steps\":%llu,\"magic_hits\":%llu,\"symbols\":%llu",
+            (unsigned long long)s->sync_passes, (unsigned long long)s->regions,
+            (unsigned long long)s->candidates, (unsigned long long)s->sweeps,
+            (unsigned long long)s->sweep_threads,
+            (unsigned long long)s->offsets, (unsigned long long)s->probe_dropped,
+            (unsigned long long)s->sdft, (unsigned long long)s->windows,
+            (unsigned long long)s->refine_calls, (unsigned long long)s->refine_steps,
+            (unsigned long long)s->magic_hits, (unsigned long long)s->symbols);
+    fprintf(o, ",\"margin\":{\"bits\":%llu,\"mean\":%.4f,\"min\":%.4f,\"hist\":[",
+            (unsigned long long)s->margin_bits, s->margin_bits ? s->margin_sum / (double)s->margin_bits : 0.0,
+            s->margin_bits ? s->margin_min : 0.0);
+    for(int i=0;i<RXS_MARGIN_BINS;i++) fprintf(o, "%s%llu", i ? "," : "", (unsigned long long)s->margin_hist[i]);
+    fputs("]}}", o);
+}
+
+#endif
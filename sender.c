@@ -3,12 +3,40 @@
  * Usage:
  *   ./sender "message"               -> outputs encoded_signal.wav (pure BFSK)
  *   ./sender "message" cover.wav     -> outputs encoded_signal.wav (BFSK mixed into cover)
+ *   ./sender --adaptive "message" cover.wav
+ *                                    -> BFSK level follows the cover's loudness
+ *   ./sender -o - "message" | ...    -> streams AU/PCM16 to stdout while encoding
+ *   ./sender --fec rep "message"     -> body sent with REP repetition (old format)
+ *   ./sender --mod 8fsk "message"    -> body as 8-FSK (also 4fsk, mc4, bfsk)
+ *   ./sender --rate 5ms "message"    -> body symbols of 5 ms, 3x faster (also
+ *                                       10ms, 7.5ms, 3.75ms; receiver --probe
+ *                                       tells which one the link takes)
+ *   ./sender --packets "message"     -> body as packets with their own CRC
+ *   ./sender --resend 3,7 --iv HEX "message"
+ *                                    -> only packets 3 and 7 of the message
+ *                                       sent under IV HEX (as reported by
+ *                                       the receiver)
+ *   ./sender --fixed-iv "message"    -> fixed demo IV, frame as older senders
  *
  * Design:
  * - BFSK in phone band: FREQ_0=1200, FREQ_1=2200
- * - BIT_DURATION=30ms, REP=3
+ * - BIT_DURATION=15ms
  * - Preamble: 1.5s of 1010...
- * - Frame: "STEG" + LEN(4, BE) + CIPHERTEXT + CRC32(frame_without_crc)
+ * - Frame: "STEG" + CODE(1) + LEN(3, BE) + CIPHERTEXT + CRC32(frame_without_crc)
+ * - Header (MAGIC, CODE, LEN) always BFSK with REP=3; the body (ciphertext
+ *   + CRC) uses the code in CODE's low nibble: rate-1/2 K=7 convolutional +
+ *   interleaver (default) or REP, and the modulation profile in its high
+ *   nibble: BFSK (default), 4-FSK, 8-FSK or 4 parallel BFSK subcarriers
+ * - --rate: body symbols shorter than the header's 15 ms, named in LEN's
+ *   top bits (modem.h); 8FSK / MC4 need 10 ms or more, 4FSK 5 ms
+ * - --packets: the body is a run of SEQ + 64 bytes + CRC32 packets, each
+ *   coded on its own (packet.h), so the receiver keeps the good ones
+ * - AES-256-CTR under a random IV per message; the IV goes first in the
+ *   body as its own coded block with a CRC (cipher.h)
+ *
+ * Framing, encryption and modulation run in libphonocrypt (phonocrypt.h);
+ * this tool takes the arguments, mixes the cover in (cover.h) and writes
+ * the WAV.
  *
  * NOTE: For best results on real phone:
  * - Keep output WAV mono 44100
@@ -20,275 +48,210 @@
 #include <string.h>
 #include <stdint.h>
 #include <math.h>
-#include <openssl/evp.h>
 #include <sndfile.h>
+#include "phonocrypt.h"
+#include "cover.h"
 
 /* ---------- TX params ---------- */
-#define SAMPLE_RATE     44100
-#define FREQ_0          1200.0
-#define FREQ_1          2200.0
-#define BIT_DURATION    0.015
-#define PREAMBLE_SECONDS 1.5
-
-#define REP             3             // repetition coding (majority decode)
-#define AMPLITUDE       0.87f         // base BFSK amplitude (pure mode)
-#define STEGO_STRENGTH  0.2f         // BFSK scale when mixing with cover
-#define COVER_GAIN      0.3f         // cover scale when mixing
-
-/* AES key/IV (fixed for demo). Real-world: random IV per message + transmit IV. */
-static unsigned char key[32] = "01234567890123456789012345678901";
-static unsigned char iv[16]  = "0123456789012345";
-
-/* ---------- AES-CTR encrypt ---------- */
-static int encrypt_aes_ctr(const unsigned char *plain, int plen,
-                           unsigned char *cipher, int cap)
-{
-    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
-    if(!ctx) return -1;
-
-    int len=0, outlen=0;
-
-    if(EVP_EncryptInit_ex(ctx, EVP_aes_256_ctr(), NULL, key, iv) != 1) goto fail;
-    if(EVP_EncryptUpdate(ctx, cipher, &len, plain, plen) != 1) goto fail;
-    outlen = len;
-    if(EVP_EncryptFinal_ex(ctx, cipher + outlen, &len) != 1) goto fail;
-    outlen += len;
-
-    EVP_CIPHER_CTX_free(ctx);
-    return (outlen <= cap) ? outlen : -1;
-
-fail:
-    EVP_CIPHER_CTX_free(ctx);
-    return -1;
-}
-
-/* ---------- CRC32 ---------- */
-static uint32_t crc32_table[256];
-
-static void crc32_init(void){
-    uint32_t poly = 0xEDB88320u;
-    for(uint32_t i=0;i<256;i++){
-        uint32_t c=i;
-        for(int k=0;k<8;k++) c = (c & 1u) ? (poly ^ (c >> 1)) : (c >> 1);
-        crc32_table[i]=c;
+#define SAMPLE_RATE     PC_SAMPLE_RATE
+#define TX_BLOCK        COVER_BLOCK   // samples per sf_write_float chunk (a cover block)
+
+/* 32 hex digits -> 16 bytes; -1 if malformed */
+static int parse_iv(const char *hex, unsigned char *out){
+    if(strlen(hex) != 2*PC_IV_LEN) return -1;
+    for(int i=0;i<PC_IV_LEN;i++){
+        unsigned v;
+        if(sscanf(hex + 2*i, "%2x", &v) != 1) return -1;
+        out[i] = (unsigned char)v;
     }
+    return 0;
 }
 
-static uint32_t crc32_compute(const uint8_t *data, size_t n){
-    uint32_t c=0xFFFFFFFFu;
-    for(size_t i=0;i<n;i++) c = crc32_table[(c ^ data[i]) & 0xFFu] ^ (c >> 8);
-    return c ^ 0xFFFFFFFFu;
-}
-
-/* ---------- WAV cover loader (mono) ---------- */
-static float *load_cover_mono(const char *path, int *out_len){
-    *out_len = 0;
-
-    SF_INFO info; memset(&info,0,sizeof(info));
-    SNDFILE *f = sf_open(path, SFM_READ, &info);
-    if(!f) return NULL;
-
-    if(info.frames<=0 || info.channels<=0){
-        sf_close(f);
-        return NULL;
+/* "3,7,9" -> seqs (malloc'd, *n of them); NULL if malformed */
+static unsigned *parse_resend(const char *list, size_t *n){
+    size_t cap = 1;
+    for(const char *p=list;*p;p++) if(*p == ',') cap++;
+    unsigned *v = (unsigned*)malloc(cap*sizeof(unsigned));
+    if(!v) return NULL;
+
+    const char *p = list;
+    *n = 0;
+    while(*p){
+        char *end;
+        long k = strtol(p, &end, 10);
+        if(end == p || k < 0 || k > 0xFFFF || *n == cap){ free(v); return NULL; }
+        v[(*n)++] = (unsigned)k;
+        p = end;
+        if(*p == ',') p++;
+        else if(*p){ free(v); return NULL; }
     }
+    return v;
+}
 
-    sf_count_t frames = info.frames;
-    int ch = info.channels;
-    sf_count_t total = frames * ch;
-
-    float *tmp = (float*)malloc((size_t)total * sizeof(float));
-    if(!tmp){ sf_close(f); return NULL; }
-
-    sf_count_t r = sf_read_float(f, tmp, total);
-    sf_close(f);
-    if(r <= 0){ free(tmp); return NULL; }
-
-    float *mono = (float*)malloc((size_t)frames * sizeof(float));
-    if(!mono){ free(tmp); return NULL; }
-
-    for(int i=0;i<(int)frames;i++){
-        double sum=0.0;
-        for(int c=0;c<ch;c++){
-            sf_count_t idx=(sf_count_t)i*ch+c;
-            if(idx < r) sum += tmp[idx];
+int main(int argc, char **argv){
+    const char *out_path = "encoded_signal.wav";
+    const char *resend = NULL, *iv_hex = NULL;
+    int adaptive = 0;
+    pc_encoder_config cfg;
+    pc_encoder_defaults(&cfg);
+    int argi = 1;
+    while(argc - argi >= 2 && argv[argi][0] == '-' && argv[argi][1]){
+        if(strcmp(argv[argi], "--packets") == 0){ cfg.packets = 1; argi++; continue; }
+        if(strcmp(argv[argi], "--fixed-iv") == 0){ cfg.fixed_iv = 1; argi++; continue; }
+        if(strcmp(argv[argi], "--adaptive") == 0){ adaptive = 1; argi++; continue; }
+        if(strcmp(argv[argi], "-o") == 0) out_path = argv[argi+1];
+        else if(strcmp(argv[argi], "--fec") == 0){
+            cfg.fec = pc_fec_find(argv[argi+1]);
+            if(cfg.fec < 0){ fprintf(stderr, "Unknown --fec %s (rep|conv)\n", argv[argi+1]); return 1; }
+        }
+        else if(strcmp(argv[argi], "--mod") == 0){
+            cfg.mod = pc_mod_find(argv[argi+1]);
+            if(cfg.mod < 0){ fprintf(stderr, "Unknown --mod %s (bfsk|4fsk|8fsk|mc4)\n", argv[argi+1]); return 1; }
         }
-        mono[i]=(float)(sum/ch);
+        else if(strcmp(argv[argi], "--rate") == 0){
+            cfg.rate = pc_rate_find(argv[argi+1]);
+            if(cfg.rate < 0){ fprintf(stderr, "Unknown --rate %s (15ms|10ms|7.5ms|5ms|3.75ms)\n", argv[argi+1]); return 1; }
+        }
+        else if(strcmp(argv[argi], "--resend") == 0){ resend = argv[argi+1]; cfg.packets = 1; }
+        else if(strcmp(argv[argi], "--iv") == 0) iv_hex = argv[argi+1];
+        else break;
+        argi += 2;
     }
 
-    free(tmp);
-    *out_len = (int)frames;
-    return mono;
-}
-
-static float clampf(float x){
-    if(x>1.f) return 1.f;
-    if(x<-1.f) return -1.f;
-    return x;
-}
-
-/* Hann window to reduce spectral splatter (helps codecs a bit) */
-static float hann(int n, int N){
-    if(N <= 1) return 1.f;
-    return 0.5f - 0.5f*cosf(2.0f*(float)M_PI*(float)n/(float)(N-1));
-}
-
-int main(int argc, char **argv){
-    if(argc < 2){
-        fprintf(stderr, "Usage: %s \"message\" [cover.wav]\n", argv[0]);
+    if(argc - argi < 1){
+        fprintf(stderr, "Usage: %s [-o out.wav|-] [--fec rep|conv] [--mod bfsk|4fsk|8fsk|mc4]\n"
+                        "          [--rate 15ms|10ms|7.5ms|5ms|3.75ms]\n"
+                        "          [--packets | --resend N,N...] [--iv HEX | --fixed-iv]\n"
+                        "          [--adaptive] \"message\" [cover.wav]\n", argv[0]);
         return 1;
     }
-
-    const char *msg = argv[1];
-    const char *cover_path = (argc >= 3) ? argv[2] : NULL;
-
-    crc32_init();
-
-    /* encrypt */
-    int msg_len = (int)strlen(msg);
-    unsigned char *cipher = (unsigned char*)malloc((size_t)msg_len + 64);
-    if(!cipher){ perror("malloc cipher"); return 1; }
-
-    int clen = encrypt_aes_ctr((const unsigned char*)msg, msg_len, cipher, msg_len + 64);
-    if(clen < 0){
-        fprintf(stderr, "Encrypt failed\n");
-        free(cipher);
+    /* a resend is only any use under the IV the message went out with */
+    if(resend && !iv_hex && !cfg.fixed_iv){
+        fprintf(stderr, "--resend needs the message's --iv or --fixed-iv (as the receiver prints it)\n");
+        return 1;
+    }
+    if(iv_hex && cfg.fixed_iv){
+        fprintf(stderr, "--iv and --fixed-iv exclude each other\n");
         return 1;
     }
 
-    /* frame: STEG + LEN + CIPHER + CRC32 */
-    size_t frame_no_crc = 4 + 4 + (size_t)clen;
-    size_t frame_total  = frame_no_crc + 4;
-
-    unsigned char *frame = (unsigned char*)malloc(frame_total);
-    if(!frame){ perror("malloc frame"); free(cipher); return 1; }
+    if(!pc_rate_fits(cfg.rate, cfg.mod)){
+        fprintf(stderr, "--rate %s is too fast for --mod %s (its tones would overlap)\n",
+                pc_rate_name(cfg.rate), pc_mod_name(cfg.mod));
+        return 1;
+    }
 
-    frame[0]='S'; frame[1]='T'; frame[2]='E'; frame[3]='G';
-    frame[4]=(clen>>24)&0xFF; frame[5]=(clen>>16)&0xFF; frame[6]=(clen>>8)&0xFF; frame[7]=(clen)&0xFF;
-    memcpy(frame+8, cipher, (size_t)clen);
+    const char *msg = argv[argi];
+    const char *cover_path = (argc - argi >= 2) ? argv[argi+1] : NULL;
+    int to_stdout = (strcmp(out_path, "-") == 0);
+    size_t len = strlen(msg);
 
-    uint32_t crc = crc32_compute(frame, frame_no_crc);
-    frame[frame_no_crc+0] = (crc>>24)&0xFF;
-    frame[frame_no_crc+1] = (crc>>16)&0xFF;
-    frame[frame_no_crc+2] = (crc>>8)&0xFF;
-    frame[frame_no_crc+3] = (crc)&0xFF;
+    /* IV: the message's own (random, or --iv for a resend), or the fixed one */
+    unsigned char msg_iv[PC_IV_LEN];
+    if(iv_hex){
+        if(parse_iv(iv_hex, msg_iv) != 0){ fprintf(stderr, "Bad --iv %s (32 hex digits)\n", iv_hex); return 1; }
+        cfg.iv = msg_iv;
+    }
 
-    free(cipher);
+    /* packets to send: all, or the --resend list */
+    unsigned *seqs = NULL;
+    if(resend){
+        seqs = parse_resend(resend, &cfg.nresend);
+        if(!seqs){
+            fprintf(stderr, "Bad --resend list %s (message has %zu packets)\n", resend, pc_packet_count(len));
+            return 1;
+        }
+        cfg.resend = seqs;
+    }
 
-    int spb = (int)lround((double)SAMPLE_RATE * (double)BIT_DURATION);
-    if(spb < 40){
-        fprintf(stderr, "BIT_DURATION too small\n");
-        free(frame);
+    pc_encoder *enc = pc_encoder_new(&cfg);
+    int rc = enc ? pc_encoder_push(enc, msg, len) : PC_ENOMEM;
+    if(rc == PC_OK) rc = pc_encoder_start(enc);
+    free(seqs);
+    if(rc != PC_OK){
+        if(rc == PC_ERANGE)
+            fprintf(stderr, "Bad --resend list %s (message has %zu packets)\n", resend, pc_packet_count(len));
+        else if(rc == PC_ETOOLONG && len <= PC_MAX_LEN) fprintf(stderr, "Message too long for --packets\n");
+        else fprintf(stderr, "%s\n", pc_strerror(rc));
+        pc_encoder_free(enc);
         return 1;
     }
 
-    int pre_bits = (int)lround(PREAMBLE_SECONDS / BIT_DURATION);
-    if(pre_bits < 32) pre_bits = 32;
-
-    long long data_bits = (long long)frame_total * 8LL;
-    long long tx_bits   = (long long)pre_bits + data_bits * (long long)REP;
-    long long total_samples = tx_bits * (long long)spb;
-
     /* cover */
-    float *cover = NULL;
-    int cover_len = 0;
+    cover_src cv;
     int use_cover = 0;
-
+    memset(&cv, 0, sizeof(cv));
     if(cover_path){
-        cover = load_cover_mono(cover_path, &cover_len);
-        if(!cover || cover_len <= 0){
+        if(cover_open(&cv, cover_path) != 0){
             fprintf(stderr, "Warning: cover load failed -> pure BFSK\n");
-            if(cover) free(cover);
-            cover = NULL;
-            cover_len = 0;
         } else {
             use_cover = 1;
-            fprintf(stderr, "Cover loaded: %s (mono samples=%d)\n", cover_path, cover_len);
+            fprintf(stderr, "Cover %s: %s (%lld frames, %d ch, %d Hz%s)\n", cv.mapped ? "mapped" : "opened",
+                    cover_path, cv.frames, cv.ch, cv.fs, cv.resample ? ", resampled" : "");
         }
     }
 
-    /* output wav */
+    /* output: WAV file, or AU on stdout ("-": WAV cannot be written to a pipe) */
     SF_INFO out; memset(&out,0,sizeof(out));
     out.samplerate = SAMPLE_RATE;
     out.channels = 1;
-    out.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+    out.format = (to_stdout ? SF_FORMAT_AU : SF_FORMAT_WAV) | SF_FORMAT_PCM_16;
 
-    const char *out_path = "encoded_signal.wav";
     SNDFILE *fo = sf_open(out_path, SFM_WRITE, &out);
     if(!fo){
-        fprintf(stderr, "Failed to open output wav\n");
-        free(frame);
-        if(cover) free(cover);
+        fprintf(stderr, "Failed to open output %s\n", out_path);
+        pc_encoder_free(enc);
+        cover_close(&cv);
         return 1;
     }
 
-    float *buf = (float*)malloc((size_t)total_samples * sizeof(float));
-    if(!buf){
+    /* samples are pulled a TX_BLOCK at a time, the cover mixed in (or
+     * clipped) and written, so memory stays constant for any length */
+    float *buf = (float*)malloc((size_t)TX_BLOCK * sizeof(float));
+    float *cbuf = use_cover ? (float*)malloc((size_t)TX_BLOCK * sizeof(float)) : NULL;
+    if(!buf || (use_cover && !cbuf)){
         perror("malloc buf");
+        free(buf);
+        free(cbuf);
         sf_close(fo);
-        free(frame);
-        if(cover) free(cover);
+        pc_encoder_free(enc);
+        cover_close(&cv);
         return 1;
     }
 
-    long long si = 0;
-
-    /* 1) preamble 1010... */
-    for(int b=0;b<pre_bits;b++){
-        int bit = (b & 1) ? 1 : 0;
-        float freq = bit ? (float)FREQ_1 : (float)FREQ_0;
-
-        for(int s=0;s<spb;s++){
-            float t = (float)si / (float)SAMPLE_RATE;
-            float w = hann(s, spb);
-            float tone = sinf(2.0f*(float)M_PI*freq*t);
-            float sig  = AMPLITUDE * w * tone;
-
-            float y;
-            if(use_cover){
-                float base = cover[(int)(si % cover_len)];
-                y = COVER_GAIN * base + STEGO_STRENGTH * sig;
-            } else {
-                y = sig;
-            }
-            buf[si++] = clampf(y);
-        }
+    int err = 0;
+    long n;
+    while(!err && (n = pc_encoder_pull(enc, buf, TX_BLOCK)) != 0){
+        if(n < 0){ err = 1; break; }
+        if(use_cover) cover_mix(&cv, cbuf, buf, (int)n, adaptive);
+        else for(long i=0;i<n;i++) buf[i] = cover_clamp(buf[i]);
+        if(sf_write_float(fo, buf, (sf_count_t)n) != (sf_count_t)n) err = 1;
     }
+    sf_close(fo);
+    free(buf);
+    free(cbuf);
 
-    /* 2) data bits with repetition */
-    for(size_t i=0;i<frame_total;i++){
-        for(int bitpos=7; bitpos>=0; bitpos--){
-            int bit = (frame[i] >> bitpos) & 1;
-            float freq = bit ? (float)FREQ_1 : (float)FREQ_0;
-
-            for(int r=0;r<REP;r++){
-                for(int s=0;s<spb;s++){
-                    float t = (float)si / (float)SAMPLE_RATE;
-                    float w = hann(s, spb);
-                    float tone = sinf(2.0f*(float)M_PI*freq*t);
-                    float sig  = AMPLITUDE * w * tone;
-
-                    float y;
-                    if(use_cover){
-                        float base = cover[(int)(si % cover_len)];
-                        y = COVER_GAIN * base + STEGO_STRENGTH * sig;
-                    } else {
-                        y = sig;
-                    }
-                    buf[si++] = clampf(y);
-                }
-            }
-        }
+    if(err){
+        fprintf(stderr, "Write to %s failed\n", out_path);
+        pc_encoder_free(enc);
+        cover_close(&cv);
+        return 1;
     }
 
-    sf_write_float(fo, buf, (sf_count_t)total_samples);
-    sf_close(fo);
-
-    printf("OK: wrote %s\n", out_path);
-    printf("Duration: %.1f sec\n", (double)total_samples / (double)SAMPLE_RATE);
+    /* status goes to stderr when stdout carries the audio */
+    FILE *st = to_stdout ? stderr : stdout;
+    fprintf(st, "OK: wrote %s\n", out_path);
+    fprintf(st, "Duration: %.1f sec\n", (double)pc_encoder_length(enc) / (double)SAMPLE_RATE);
+    if(!cfg.fixed_iv){
+        const unsigned char *iv = pc_encoder_iv(enc);
+        fprintf(st, "IV: ");
+        for(int i=0;i<PC_IV_LEN;i++) fprintf(st, "%02x", iv[i]);
+        fputc('\n', st);
+    }
+    if(use_cover && adaptive && cv.blocks > 0)
+        fprintf(st, "Adaptive strength: min %.3f mean %.3f max %.3f\n", cv.s_min, cv.s_sum / (double)cv.blocks, cv.s_max);
 
-    free(buf);
-    free(frame);
-    if(cover) free(cover);
+    pc_encoder_free(enc);
+    cover_close(&cv);
     return 0;
 }
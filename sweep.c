@@ -0,0 +1,345 @@
+/*
+ * sweep.c - Monte-Carlo BER/FER sweep of the link
+ * Usage:
+ *   ./sweep [--snr -18,-12,-6] [--preset none,pstn] [--noise awgn,mix]
+ *           [--fec rep,conv] [--mod bfsk,4fsk] [--rate 15ms,5ms] [--packets]
+ *           [--bytes N] [--lead SEC] [--jobs N] [--seed N] [--min N] [--max N]
+ *           [--rel R] [--abs A] [--confidence C] [--target FER]
+ *
+ * One point per SNR x preset x noise x code x modulation x body rate
+ * (pairs whose tones would overlap at that rate are left out). A trial frames a
+ * fresh random message, puts it after a random lead-in of silence, runs it
+ * through the channel (channel.h) and decodes it in-process
+ * (libphonocrypt); workers on all cores take trials from the unfinished
+ * points in turn. A point stops, after at least --min frames, once the
+ * Wilson interval of its FER is within --rel of the estimate (or --abs),
+ * once --target lies outside it, or at --max frames.
+ *
+ * FER counts frames not recovered exactly. BER compares the plaintext bit
+ * for bit (a lost packet reads '?'); the bits of a frame that gave no
+ * plaintext at all count as half wrong, a coin flip per bit. One JSON line
+ * per point, in grid order; a progress line per finished point on stderr.
+ * REP and the header's BIT_DURATION are compile-time constants of the
+ * library; the body's symbol rate is a grid axis: compare "airtime" at the
+ * target FER.
+ *   gcc -O2 sweep.c phonocrypt.c -o sweep -lssl -lcrypto -lm -lpthread
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "phonocrypt.h"
+#include "channel.h"
+
+#define SWEEP_MAX_LIST      64
+#define SWEEP_MAX_THREADS   256
+
+typedef struct {
+    double snr;
+    int preset, noise, fec, mod, rate;
+    long long airtime;          /* frame samples, without the lead-in */
+    long issued, frames, errors;
+    double bits, bit_errors;
+    const char *stop;           /* NULL while trials are handed out */
+} sweep_point;
+
+typedef struct {
+    sweep_point *pt;
+    int npt, live, cursor;
+    int packets, bytes;
+    double lead, z, rel, abs_tol, target;
+    long min_frames, max_frames;
+    uint64_t seed;
+    pthread_mutex_t lock;
+} sweep_ctx;
+
+/* Wilson score interval of k in n */
+static void wilson(long k, long n, double z, double *lo, double *hi){
+    if(n == 0){ *lo = 0.0; *hi = 1.0; return; }
+    double p = (double)k / n, z2 = z*z;
+    double c = (p + z2/(2.0*n)) / (1.0 + z2/n);
+    double h = z * sqrt(p*(1.0 - p)/n + z2/(4.0*n*n)) / (1.0 + z2/n);
+    *lo = (k > 0 && c - h > 0.0) ? c - h : 0.0;
+    *hi = (k < n && c + h < 1.0) ? c + h : 1.0;
+}
+
+/* two-sided normal quantile of confidence c, by bisection on erf */
+static double z_of(double c){
+    double lo = 0.0, hi = 10.0;
+    for(int i=0;i<100;i++){
+        double m = 0.5*(lo + hi);
+        if(erf(m / sqrt(2.0)) < c) lo = m; else hi = m;
+    }
+    return 0.5*(lo + hi);
+}
+
+static int popcount8(unsigned v){
+    int c = 0;
+    for(;v;v>>=1) c += (int)(v & 1);
+    return c;
+}
+
+/* One frame through the channel and the decoder; 0, or -1 if a library
+ * call failed (not counted) */
+static int run_trial(const sweep_ctx *s, const sweep_point *p, uint64_t seed,
+                     int *frame_err, double *bit_err){
+    chan_rng r;
+    chan_rng_seed(&r, seed);
+    int rc = -1;
+    float *x = NULL, *y = NULL;
+    pc_decoder *d = NULL;
+    unsigned char *msg = (unsigned char*)malloc((size_t)s->bytes);
+    unsigned char *plain = (unsigned char*)malloc((size_t)s->bytes + 64);
+    for(int i=0;msg && i<s->bytes;i++) msg[i] = (unsigned char)(chan_rng_next(&r) >> 56);
+
+    pc_encoder_config ec;
+    pc_encoder_defaults(&ec);
+    ec.fec = p->fec;
+    ec.mod = p->mod;
+    ec.rate = p->rate;
+    ec.packets = s->packets;
+    pc_encoder *e = pc_encoder_new(&ec);
+    if(!e || !msg || !plain || pc_encoder_push(e, msg, (size_t)s->bytes) != PC_OK || pc_encoder_start(e) != PC_OK) goto out;
+
+    long long lead = (long long)(chan_uniform(&r) * s->lead * PC_SAMPLE_RATE);
+    long long n = lead + pc_encoder_length(e);
+    x = (float*)calloc((size_t)n, sizeof(float));
+    if(!x || pc_encoder_pull(e, x + lead, (long)(n - lead)) != n - lead) goto out;
+
+    long long m = chan_out_len(n, PC_SAMPLE_RATE, p->preset);
+    y = (float*)malloc((size_t)m*sizeof(float));
+    if(!y || chan_apply(p->preset, p->noise, p->snr, chan_rng_next(&r), x, n, PC_SAMPLE_RATE, y) != 0) goto out;
+
+    pc_decoder_config dc;
+    pc_decoder_defaults(&dc);
+    dc.frames = m;
+    d = pc_decoder_new(&dc);
+    if(!d || pc_decoder_push(d, y, m) != PC_OK || pc_decoder_finish(d) != PC_OK) goto out;
+
+    pc_info info;
+    pc_decoder_info(d, &info);
+    long k = pc_decoder_pull(d, plain, s->bytes + 64);
+    *frame_err = !info.ok || k != s->bytes || memcmp(plain, msg, (size_t)s->bytes) != 0;
+    if(k <= 0) *bit_err = 4.0 * s->bytes;
+    else {
+        long errs = 0;
+        for(int i=0;i<s->bytes;i++) errs += popcount8((i < k) ? (unsigned)(plain[i] ^ msg[i]) : 0xFFu);
+        *bit_err = (double)errs;
+    }
+    rc = 0;
+
+out:
+    pc_decoder_free(d);
+    pc_encoder_free(e);
+    free(y);
+    free(x);
+    free(plain);
+    free(msg);
+    return rc;
+}
+
+/* Next point that still hands out trials, round robin; -1 when none */
+static int take_point(sweep_ctx *s){
+    for(int i=0;i<s->npt;i++){
+        int j = (s->cursor + i) % s->npt;
+        sweep_point *p = &s->pt[j];
+        if(!p->stop && p->issued < s->max_frames){
+            s->cursor = j + 1;
+            return j;
+        }
+    }
+    return -1;
+}
+
+static const char *stop_reason(const sweep_ctx *s, const sweep_point *p){
+    if(p->frames < s->min_frames) return NULL;
+    double lo, hi, fer = (double)p->errors / p->frames;
+    wilson(p->errors, p->frames, s->z, &lo, &hi);
+    double tol = s->rel * fer;
+    if(tol < s->abs_tol) tol = s->abs_tol;
+    if(0.5*(hi - lo) <= tol) return "converged";
+    if(s->target > 0.0 && (hi < s->target || lo > s->target)) return "decided";
+    if(p->frames >= s->max_frames) return "max";
+    return NULL;
+}
+
+static void print_point(FILE *o, const sweep_ctx *s, const sweep_point *p){
+    double lo, hi;
+    wilson(p->errors, p->frames, s->z, &lo, &hi);
+    fprintf(o, "{\"snr\":%g,\"preset\":\"%s\",\"noise\":\"%s\",\"fec\":\"%s\",\"mod\":\"%s\",\"rate\":\"%s\","
+               "\"packets\":%s,\"bytes\":%d,\"airtime\":%.3f,\"frames\":%ld,\"frame_errors\":%ld,\"fer\":%.6g,\"fer_lo\":%.6g,"
+               "\"fer_hi\":%.6g,\"ber\":%.6g,\"stop\":\"%s\"}\n",
+            p->snr, chan_preset_names[p->preset], chan_noise_names[p->noise], pc_fec_name(p->fec),
+            pc_mod_name(p->mod), pc_rate_name(p->rate), s->packets ? "true" : "false", s->bytes,
+            (double)p->airtime / PC_SAMPLE_RATE, p->frames, p->errors,
+            p->frames ? (double)p->errors / p->frames : 0.0, lo, hi,
+            p->bits > 0 ? p->bit_errors / p->bits : 0.0, p->stop ? p->stop : "max");
+}
+
+static void *sweep_worker(void *arg){
+    sweep_ctx *s = (sweep_ctx*)arg;
+    for(;;){
+        pthread_mutex_lock(&s->lock);
+        int j = take_point(s);
+        long t = (j >= 0) ? s->pt[j].issued++ : 0;
+        pthread_mutex_unlock(&s->lock);
+        if(j < 0) break;
+
+        sweep_point *p = &s->pt[j];
+        uint64_t seed = s->seed ^ ((uint64_t)(j + 1) * 0x9E3779B97F4A7C15ull) ^ ((uint64_t)t * 0xD1B54A32D192ED03ull);
+        int ferr = 0;
+        double berr = 0.0;
+        int rc = run_trial(s, p, seed, &ferr, &berr);
+
+        pthread_mutex_lock(&s->lock);
+        if(rc == 0){
+            p->frames++;
+            p->errors += ferr;
+            p->bits += 8.0 * s->bytes;
+            p->bit_errors += berr;
+        }
+        /* the library could not run the trial (out of memory): give up the point */
+        if(!p->stop && (p->stop = (rc != 0) ? "failed" : stop_reason(s, p)) != NULL){
+            s->live--;
+            fprintf(stderr, "[sweep] %d left: snr=%g %s/%s %s/%s/%s fer=%.4g n=%ld (%s)\n",
+                    s->live, p->snr, chan_preset_names[p->preset], chan_noise_names[p->noise],
+                    pc_fec_name(p->fec), pc_mod_name(p->mod), pc_rate_name(p->rate),
+                    p->frames ? (double)p->errors / p->frames : 0.0, p->frames, p->stop);
+        }
+        pthread_mutex_unlock(&s->lock);
+    }
+    return NULL;
+}
+
+/* Comma-separated names through find into v; count, or -1 */
+static int parse_names(const char *list, int (*find)(const char*), int *v){
+    char buf[256];
+    int n = 0;
+    if(strlen(list) >= sizeof(buf)) return -1;
+    strcpy(buf, list);
+    for(char *save, *t = strtok_r(buf, ",", &save); t; t = strtok_r(NULL, ",", &save)){
+        if(n == SWEEP_MAX_LIST || (v[n] = find(t)) < 0) return -1;
+        n++;
+    }
+    return n ? n : -1;
+}
+
+static int parse_snrs(const char *list, double *v){
+    const char *p = list;
+    int n = 0;
+    while(*p){
+        char *end;
+        double s = strtod(p, &end);
+        if(end == p || n == SWEEP_MAX_LIST) return -1;
+        v[n++] = s;
+        p = end;
+        if(*p == ',') p++;
+        else if(*p) return -1;
+    }
+    return n ? n : -1;
+}
+
+static int find_preset(const char *s){ return chan_find(chan_preset_names, s); }
+static int find_noise(const char *s){ return chan_find(chan_noise_names, s); }
+
+int main(int argc, char **argv){
+    double snr[SWEEP_MAX_LIST] = { -18, -15, -12, -9 };
+    int preset[SWEEP_MAX_LIST] = { CHAN_NONE }, noise[SWEEP_MAX_LIST] = { CHAN_AWGN };
+    int fec[SWEEP_MAX_LIST] = { PC_FEC_REP, PC_FEC_CONV }, mod[SWEEP_MAX_LIST] = { PC_MOD_BFSK };
+    int rate[SWEEP_MAX_LIST] = { PC_RATE_15MS };
+    int nsnr = 4, npreset = 1, nnoise = 1, nfec = 2, nmod = 1, nrate = 1;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int jobs = (ncpu > 0) ? (int)ncpu : 1, bad = 0;
+    double confidence = 0.95;
+
+    sweep_ctx s;
+    memset(&s, 0, sizeof(s));
+    s.bytes = 32;
+    s.lead = 0.25;
+    s.rel = 0.2;
+    s.abs_tol = 0.01;
+    s.min_frames = 20;
+    s.max_frames = 2000;
+    s.seed = 1;
+
+    for(int i=1;i<argc && !bad;i++){
+        const char *a = argv[i], *v = (i+1 < argc) ? argv[i+1] : NULL;
+        if(strcmp(a, "--packets") == 0){ s.packets = 1; continue; }
+        if(!v){ bad = 1; break; }
+        i++;
+        if(strcmp(a, "--snr") == 0) bad = (nsnr = parse_snrs(v, snr)) < 0;
+        else if(strcmp(a, "--preset") == 0) bad = (npreset = parse_names(v, find_preset, preset)) < 0;
+        else if(strcmp(a, "--noise") == 0) bad = (nnoise = parse_names(v, find_noise, noise)) < 0;
+        else if(strcmp(a, "--fec") == 0) bad = (nfec = parse_names(v, pc_fec_find, fec)) < 0;
+        else if(strcmp(a, "--mod") == 0) bad = (nmod = parse_names(v, pc_mod_find, mod)) < 0;
+        else if(strcmp(a, "--rate") == 0) bad = (nrate = parse_names(v, pc_rate_find, rate)) < 0;
+        else if(strcmp(a, "--bytes") == 0) s.bytes = atoi(v);
+        else if(strcmp(a, "--lead") == 0) s.lead = atof(v);
+        else if(strcmp(a, "--jobs") == 0) jobs = atoi(v);
+        else if(strcmp(a, "--seed") == 0) s.seed = strtoull(v, NULL, 10);
+        else if(strcmp(a, "--min") == 0) s.min_frames = atol(v);
+        else if(strcmp(a, "--max") == 0) s.max_frames = atol(v);
+        else if(strcmp(a, "--rel") == 0) s.rel = atof(v);
+        else if(strcmp(a, "--abs") == 0) s.abs_tol = atof(v);
+        else if(strcmp(a, "--confidence") == 0) confidence = atof(v);
+        else if(strcmp(a, "--target") == 0) s.target = atof(v);
+        else bad = 1;
+    }
+    if(bad || s.bytes < 1 || s.bytes >= (1 << 24) || s.lead < 0.0 || jobs < 1 || s.min_frames < 1
+       || s.max_frames < s.min_frames || confidence <= 0.0 || confidence >= 1.0){
+        fprintf(stderr, "Usage: %s [--snr -18,-12,-6] [--preset none,pstn] [--noise awgn,mix]\n"
+                        "          [--fec rep,conv] [--mod bfsk,4fsk] [--rate 15ms,5ms] [--packets]\n"
+                        "          [--bytes N] [--lead SEC] [--jobs N] [--seed N] [--min N] [--max N]\n"
+                        "          [--rel R] [--abs A] [--confidence C] [--target FER]\n", argv[0]);
+        return 2;
+    }
+    if(jobs > SWEEP_MAX_THREADS) jobs = SWEEP_MAX_THREADS;
+    s.z = z_of(confidence);
+
+    /* the grid, and each point's airtime from a frame of the right size */
+    s.npt = nsnr * npreset * nnoise * nfec * nmod * nrate;
+    s.pt = (sweep_point*)calloc((size_t)s.npt, sizeof(sweep_point));
+    unsigned char *zero = (unsigned char*)calloc((size_t)s.bytes, 1);
+    if(!s.pt || !zero){ fprintf(stderr, "Out of memory\n"); return 1; }
+    int k = 0;
+    for(int a=0;a<nsnr;a++) for(int b=0;b<npreset;b++) for(int c=0;c<nnoise;c++)
+    for(int f=0;f<nfec;f++) for(int m=0;m<nmod;m++) for(int q=0;q<nrate;q++){
+        if(!pc_rate_fits(rate[q], mod[m])) continue;
+        sweep_point *p = &s.pt[k++];
+        p->snr = snr[a]; p->preset = preset[b]; p->noise = noise[c]; p->fec = fec[f]; p->mod = mod[m];
+        p->rate = rate[q];
+        pc_encoder_config ec;
+        pc_encoder_defaults(&ec);
+        ec.fec = p->fec; ec.mod = p->mod; ec.rate = p->rate; ec.packets = s.packets;
+        pc_encoder *e = pc_encoder_new(&ec);
+        int rc = e ? pc_encoder_push(e, zero, (size_t)s.bytes) : PC_ENOMEM;
+        if(rc == PC_OK) rc = pc_encoder_start(e);
+        if(rc != PC_OK){ fprintf(stderr, "Cannot frame %d bytes: %s\n", s.bytes, pc_strerror(rc)); return 1; }
+        p->airtime = pc_encoder_length(e);
+        pc_encoder_free(e);
+    }
+    free(zero);
+    if(k == 0){ fprintf(stderr, "No point: every --rate is too fast for every --mod\n"); return 2; }
+    s.npt = k;
+    s.live = s.npt;
+    pthread_mutex_init(&s.lock, NULL);
+
+    pthread_t tid[SWEEP_MAX_THREADS];
+    int started = 0;
+    for(int t=1;t<jobs;t++){
+        if(pthread_create(&tid[started], NULL, sweep_worker, &s) != 0) break;
+        started++;
+    }
+    sweep_worker(&s);
+    for(int t=0;t<started;t++) pthread_join(tid[t], NULL);
+
+    for(int i=0;i<s.npt;i++) print_point(stdout, &s, &s.pt[i]);
+    pthread_mutex_destroy(&s.lock);
+    free(s.pt);
+    pc_cleanup();
+    return 0;
+}
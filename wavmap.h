@@ -0,0 +1,142 @@
+/*
+ * wavmap.h - zero-copy read path for 16-bit PCM WAV files
+ *
+ * The file is mmap'ed and its RIFF header parsed directly; samples stay
+ * int16 in the mapping and are converted (downmixed to mono or kept
+ * interleaved, scaled by 1/32768 like libsndfile) only for the block a
+ * caller asks for.
+ * Anything that is not plain PCM16 WAV makes wavmap_open fail, and the
+ * caller falls back to libsndfile.
+ */
+#ifndef WAVMAP_H
+#define WAVMAP_H
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef struct {
+    void *map;
+    size_t map_len;
+    const uint8_t *data;   /* first byte of interleaved PCM16 frames */
+    long long frames;
+    int channels;
+    int samplerate;
+} wavmap;
+
+static inline uint32_t wavmap_le32(const uint8_t *p){
+    return (uint32_t)p[0] | ((uint32_t)p[1]<<8) | ((uint32_t)p[2]<<16) | ((uint32_t)p[3]<<24);
+}
+
+static inline uint16_t wavmap_le16(const uint8_t *p){
+    return (uint16_t)(p[0] | (p[1]<<8));
+}
+
+static inline void wavmap_close(wavmap *w){
+    if(w->map) munmap(w->map, w->map_len);
+    memset(w, 0, sizeof(*w));
+}
+
+/* 0 on success, -1 if the file can't be mapped or isn't PCM16 WAV */
+static inline int wavmap_open(wavmap *w, const char *path){
+    memset(w, 0, sizeof(*w));
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return -1;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < 44){ close(fd); return -1; }
+
+    void *m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(m == MAP_FAILED) return -1;
+    w->map = m;
+    w->map_len = (size_t)st.st_size;
+
+    const uint8_t *p = (const uint8_t*)m;
+    const uint8_t *end = p + w->map_len;
+    if(memcmp(p, "RIFF", 4) != 0 || memcmp(p + 8, "WAVE", 4) != 0) goto fail;
+
+    int have_fmt = 0;
+    for(const uint8_t *c = p + 12; c + 8 <= end; ){
+        uint32_t sz = wavmap_le32(c + 4);
+        const uint8_t *body = c + 8;
+
+        if(memcmp(c, "fmt ", 4) == 0){
+            if(sz < 16 || body + 16 > end) goto fail;
+            uint16_t fmt  = wavmap_le16(body);
+            uint16_t bits = wavmap_le16(body + 14);
+            if(fmt == 0xFFFE && sz >= 26 && body + 26 <= end) fmt = wavmap_le16(body + 24);
+            if(fmt != 1 || bits != 16) goto fail;
+            w->channels   = wavmap_le16(body + 2);
+            w->samplerate = (int)wavmap_le32(body + 4);
+            if(w->channels <= 0 || w->samplerate <= 0) goto fail;
+            have_fmt = 1;
+        } else if(memcmp(c, "data", 4) == 0){
+            if(!have_fmt) goto fail;
+            size_t avail = (size_t)(end - body);
+            size_t bytes = (sz > avail) ? avail : sz;   /* truncated file */
+            w->data = body;
+            w->frames = (long long)(bytes / (2u * (size_t)w->channels));
+            if(w->frames <= 0) goto fail;
+            madvise(m, w->map_len, MADV_SEQUENTIAL);
+            return 0;
+        }
+
+        if((size_t)(end - body) < sz) break;
+        c = body + sz + (sz & 1u);
+    }
+
+fail:
+    wavmap_close(w);
+    return -1;
+}
+
+/* Convert frames [frame, frame+count) to mono float; returns frames written */
+static inline long long wavmap_read(const wavmap *w, long long frame, float *mono, long long count){
+    if(frame >= w->frames) return 0;
+    if(count > w->frames - frame) count = w->frames - frame;
+
+    int ch = w->channels;
+    const uint8_t *p = w->data + (size_t)frame * 2u * (size_t)ch;
+    if(ch == 1 || ch == 2){
+        /* 1/(32768*ch) is a power of two: the product is the exact quotient */
+        const float scale = 1.0f / (32768.0f * (float)ch);
+        for(long long i=0;i<count;i++, p+=2u*(size_t)ch){
+            int sum = (int16_t)wavmap_le16(p);
+            if(ch == 2) sum += (int16_t)wavmap_le16(p + 2);
+            mono[i] = (float)sum * scale;
+        }
+        return count;
+    }
+    for(long long i=0;i<count;i++){
+        int sum = 0;
+        for(int c=0;c<ch;c++, p+=2) sum += (int16_t)wavmap_le16(p);
+        mono[i] = (float)sum / (32768.0f * (float)ch);
+    }
+    return count;
+}
+
+/* Frames [frame, frame+count) as interleaved float; returns frames written */
+static inline long long wavmap_read_frames(const wavmap *w, long long frame, float *out, long long count){
+    if(frame >= w->frames) return 0;
+    if(count > w->frames - frame) count = w->frames - frame;
+
+    const uint8_t *p = w->data + (size_t)frame * 2u * (size_t)w->channels;
+    long long ns = count * w->channels;
+    for(long long i=0;i<ns;i++, p+=2) out[i] = (float)(int16_t)wavmap_le16(p) * (1.0f / 32768.0f);
+    return count;
+}
+
+/* Pages before frame have been consumed: let the kernel drop them */
+static inline void wavmap_release(const wavmap *w, long long frame){
+    long pg = sysconf(_SC_PAGESIZE);
+    if(pg <= 0 || frame <= 0) return;
+    size_t off = (size_t)(w->data - (const uint8_t*)w->map) + (size_t)frame * 2u * (size_t)w->channels;
+    off -= off % (size_t)pg;
+    if(off > 0) madvise(w->map, off, MADV_DONTNEED);
+}
+
+#endif